@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""Time each instruction handler of the MC88100 simulators.
+
+    microbench.py --sim PATH [--engine NAME=ARGS ...] [--iters N]
+                  [--warmup W] [--repeats R] [--csv FILE] [HANDLER ...]
+
+Each handler gets a guest loop whose body is UNROLL copies of one
+instruction, followed by the loop control (sub and bcnd). jsr_jmp is
+the exception: each copy is a jsr to a subroutine that returns with
+jmp r1, so it times a call and its return together. A baseline
+loop with an empty body runs the same number of iterations. The cost of
+the handler is
+
+    ( seconds( handler loop ) - seconds( baseline loop ) )
+        / ( UNROLL * iterations )
+
+using the wall_seconds that the simulator reports in its JSON stats.
+Startup, program loading and the loop control cancel out.
+
+Each measurement starts with W warm-up runs that are discarded. Then R
+handler and baseline runs are interleaved, so that drift in the host
+affects both equally. The report gives the median over the R pairs, the
+median absolute deviation (MAD) and the fastest pair.
+
+--engine names an engine and the simulator options that select it. It
+may be repeated to compare engines; the default is the switch engine
+and the threaded engine (--engine threaded). --csv appends one row per
+handler and engine, so that runs can be compared over time.
+"""
+
+import argparse
+import json
+import os
+import shlex
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from mkbench import DATA, Program  # noqa: E402
+
+UNROLL = 64
+
+# registers set up before the loop
+#   r1 link register, r2 loop counter, r3 data address, r4 zero index,
+#   r5 nonzero value, r6 .. destination, r8 the subroutine of jsr_jmp,
+#   r9 and r10 single precision 1.5 and 2.0
+SUBROUTINE = 4
+SETUP = {2: None, 3: DATA, 4: 0, 5: 0x1234, 8: SUBROUTINE,
+         9: 0x3fc00000, 10: 0x40000000}
+
+
+def next_word(branch):
+    """a branch to the next word, which is taken"""
+    return lambda p, k: (branch(p, "n%d" % k), p.label("n%d" % k))
+
+
+HANDLERS = {
+    "imm_ld": lambda p, k: p.ld_i(6, 3, 0),
+    "imm_st": lambda p, k: p.st_i(5, 3, 0),
+    "imm_lda": lambda p, k: p.lda_i(6, 3, 4),
+    "imm_add": lambda p, k: p.add_i(6, 6, 1),
+    "imm_sub": lambda p, k: p.sub_i(6, 6, 1),
+    "br": next_word(lambda p, n: p.br(n)),
+    "bcnd_taken": lambda p, k: (p.bcnd("ne0", 5, "n%d" % k),
+                                p.label("n%d" % k)),
+    "bcnd_not_taken": lambda p, k: (p.bcnd("eq0", 5, "n%d" % k),
+                                    p.label("n%d" % k)),
+    "ext": lambda p, k: p.ext(6, 5, 3),
+    "extu": lambda p, k: p.extu(6, 5, 3),
+    "mak": lambda p, k: p.mak(6, 5, 3),
+    "rot": lambda p, k: p.rot(6, 5, 3),
+    "ld": lambda p, k: p.ld(6, 3, 4),
+    "ld_scaled": lambda p, k: p.ld(6, 3, 4, 1),
+    "st": lambda p, k: p.st(5, 3, 4),
+    "st_scaled": lambda p, k: p.st(5, 3, 4, 1),
+    "lda": lambda p, k: p.lda(6, 3, 4),
+    "lda_scaled": lambda p, k: p.lda(6, 3, 4, 1),
+    "add": lambda p, k: p.add(6, 6, 5),
+    "sub": lambda p, k: p.sub(6, 6, 5),
+    "imm_and": lambda p, k: p.and_i(6, 5, 0xff0f),
+    "and_u": lambda p, k: p.and_u(6, 5, 0xff0f),
+    "mask": lambda p, k: p.mask_i(6, 5, 0xff0f),
+    "mask_u": lambda p, k: p.mask_u(6, 5, 0xff0f),
+    "imm_xor": lambda p, k: p.xor_i(6, 6, 0xff0f),
+    "xor_u": lambda p, k: p.xor_u(6, 6, 0xff0f),
+    "imm_or": lambda p, k: p.or_i(6, 5, 0xff0f),
+    "or_u": lambda p, k: p.or_u(6, 5, 0xff0f),
+    "and": lambda p, k: p.and_(6, 6, 5),
+    "and_c": lambda p, k: p.and_c(6, 6, 5),
+    "xor": lambda p, k: p.xor(6, 6, 5),
+    "xor_c": lambda p, k: p.xor_c(6, 6, 5),
+    "or": lambda p, k: p.or_(6, 6, 5),
+    "or_c": lambda p, k: p.or_c(6, 6, 5),
+    "imm_mul": lambda p, k: p.mul_i(6, 5, 3),
+    "imm_div": lambda p, k: p.div_i(6, 5, 3),
+    "imm_divu": lambda p, k: p.divu_i(6, 5, 3),
+    "mul": lambda p, k: p.mul(6, 5, 5),
+    "div": lambda p, k: p.div(6, 5, 5),
+    "divu": lambda p, k: p.divu(6, 5, 5),
+    "bsr": next_word(lambda p, n: p.bsr(n)),
+    "jsr_jmp": lambda p, k: p.jsr(8),
+    "imm_cmp": lambda p, k: p.cmp_i(6, 5, 3),
+    "cmp": lambda p, k: p.cmp(6, 5, 4),
+    "bb0_taken": next_word(lambda p, n: p.bb0(0, 5, n)),
+    "bb0_not_taken": next_word(lambda p, n: p.bb0(2, 5, n)),
+    "bb1_taken": next_word(lambda p, n: p.bb1(2, 5, n)),
+    "bb1_not_taken": next_word(lambda p, n: p.bb1(0, 5, n)),
+    "fadd": lambda p, k: p.fadd(6, 9, 10),
+    "fsub": lambda p, k: p.fsub(6, 9, 10),
+    "fmul": lambda p, k: p.fmul(6, 9, 10),
+    "fdiv": lambda p, k: p.fdiv(6, 9, 10),
+    "flt": lambda p, k: p.flt(6, 5),
+    "int": lambda p, k: p.int_(6, 9),
+}
+
+
+def loop_program(handler, iters):
+    p = Program()
+    p.br("start")
+    p.label("subroutine")       # at SUBROUTINE
+    p.jmp(1)
+    p.label("start")
+    for r, value in SETUP.items():
+        p.li(r, iters if value is None else value)
+    p.label("loop")
+    if handler:
+        for k in range(UNROLL):
+            HANDLERS[handler](p, k)
+    p.sub_i(2, 2, 1)
+    p.bcnd("ne0", 2, "loop")
+    p.halt()
+    return "".join("%08x\n" % w for w in p.words())
+
+
+def seconds(sim, args, image):
+    with tempfile.TemporaryFile("w+") as f:
+        f.write(image)
+        f.seek(0)
+        out = subprocess.run([sim, "--stats-format=json"] + args, stdin=f,
+                             stdout=subprocess.PIPE, check=True, text=True)
+    return json.loads(out.stdout)["host"]["wall_seconds"]
+
+
+def measure(sim, args, handler, baseline, iters, warmup, repeats):
+    """nanoseconds per instruction for each interleaved pair"""
+    image = loop_program(handler, iters)
+    for _ in range(warmup):
+        seconds(sim, args, image)
+        seconds(sim, args, baseline)
+    ns = []
+    for _ in range(repeats):
+        t = seconds(sim, args, image) - seconds(sim, args, baseline)
+        ns.append(1e9 * t / (UNROLL * iters))
+    return ns
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--sim", required=True, help="simulator binary")
+    parser.add_argument("--engine", action="append", metavar="NAME=ARGS",
+                        help="engine name and the options that select it")
+    parser.add_argument("--iters", type=int, default=100000,
+                        help="loop iterations per run (default 100000)")
+    parser.add_argument("--warmup", type=int, default=2)
+    parser.add_argument("--repeats", type=int, default=7)
+    parser.add_argument("--csv", help="append the results to this file")
+    parser.add_argument("handlers", nargs="*",
+                        help="handlers to time (default all)")
+    args = parser.parse_args()
+
+    if args.repeats < 1 or args.iters < 1:
+        sys.exit("REPEATS and ITERS must be positive")
+    for h in args.handlers:
+        if h not in HANDLERS:
+            sys.exit("unknown handler %s, expected one of %s" % (
+                h, " ".join(HANDLERS)))
+    engines = []
+    for e in args.engine or ["switch=", "threaded=--engine threaded"]:
+        name, _, options = e.partition("=")
+        engines.append((name, shlex.split(options)))
+    handlers = args.handlers or list(HANDLERS)
+
+    baseline = loop_program(None, args.iters)
+    rows = []
+    for name, options in engines:
+        print("engine %s (%d x %d instructions, %d repeats):" % (
+            name, UNROLL, args.iters, args.repeats))
+        print("  %-16s %9s %9s %9s" % ("handler", "median", "MAD", "min"))
+        for h in handlers:
+            ns = measure(args.sim, options, h, baseline, args.iters,
+                         args.warmup, args.repeats)
+            med = statistics.median(ns)
+            mad = statistics.median(abs(x - med) for x in ns)
+            rows.append((name, h, med, mad, min(ns)))
+            print("  %-16s %7.2fns %7.2fns %7.2fns" % (h, med, mad, min(ns)))
+
+    if args.csv:
+        new = not os.path.exists(args.csv)
+        stamp = time.strftime("%Y-%m-%dT%H:%M:%S")
+        with open(args.csv, "a") as f:
+            if new:
+                f.write("time,sim,engine,handler,median_ns,mad_ns,min_ns\n")
+            for name, h, med, mad, low in rows:
+                f.write("%s,%s,%s,%s,%.3f,%.3f,%.3f\n" % (
+                    stamp, args.sim, name, h, med, mad, low))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,547 @@
+#!/usr/bin/env python3
+"""Generate the MC88100 benchmark programs.
+
+Each benchmark is a parameterised guest program written in the
+instruction subset that the simulators implement. It is emitted in the
+same format as the tc*.in files, one hex word per line. Every program leaves
+a checksum in r2 before it halts. The generator computes the reference
+value directly from the algorithm, so a run can be checked with
+
+    sim --stats-format=json --mem-size MIB < prog.in
+
+by comparing registers.r2 with the value printed by --expect.
+
+    mkbench.py NAME [-n N] [-r REPS] > prog.in
+    mkbench.py NAME [-n N] [-r REPS] --expect
+
+--expect prints the expected r2 and the memory size in MiB the run
+needs. The programs are
+
+    memset    fill N words, REPS times, with a new value each time
+    memcpy    copy N pseudo-random words, REPS times
+    matmul    N x N matrix product
+    list      walk a pseudo-randomly linked list of N nodes REPS times
+    bsearch   N lower-bound searches in a sorted array of N words,
+              REPS times
+    histogram bucket N pseudo-random words into 256 counters REPS times
+    sort      insertion sort of N pseudo-random words (REPS is ignored)
+
+Pseudo-random data comes from x = 5 * x + 12345 (mod 2^32) starting at
+x = 1. The multiplication by 5 is done as (x << 2) + x.
+"""
+
+import argparse
+import sys
+
+MASK = 0xffffffff
+DATA = 0x1000          # byte address of the first data array
+INPUT_WORD_LIMIT = 256 * 1024  # words in the default 1 MiB memory
+
+
+# --- encoder for the instruction subset, see the header of lib/core.c -------
+
+COND = {"eq0": 0x2, "ne0": 0xd, "gt0": 0x1, "lt0": 0xc, "ge0": 0x3,
+        "le0": 0xe, "always": 0xf}
+
+
+class Program:
+    def __init__(self):
+        self.items = []     # encoder functions of (labels, pc), or labels
+        self.labels = {}
+
+    def label(self, name):
+        self.items.append(name)
+
+    def emit(self, fn):
+        self.items.append(fn)
+
+    def imm(self, op1, d, s1, imm16):
+        assert 0 <= imm16 <= 0xffff, imm16
+        word = (op1 << 26) | (d << 21) | (s1 << 16) | imm16
+        self.emit(lambda labels, pc: word)
+
+    def triadic(self, op2, d, s1, s2, scaled=0):
+        word = (0x3d << 26) | (d << 21) | (s1 << 16) | (op2 << 10) \
+            | (scaled << 9) | s2
+        self.emit(lambda labels, pc: word)
+
+    def bitfield(self, op2, d, s1, o5):
+        assert 0 <= o5 < 32
+        word = (0x3c << 26) | (d << 21) | (s1 << 16) | (op2 << 10) | o5
+        self.emit(lambda labels, pc: word)
+
+    # register indirect with zero-extended immediate
+    def ld_i(self, d, s1, imm): self.imm(0x05, d, s1, imm)
+    def st_i(self, d, s1, imm): self.imm(0x09, d, s1, imm)
+    def lda_i(self, d, s1, imm): self.imm(0x0d, d, s1, imm)
+    def add_i(self, d, s1, imm): self.imm(0x1c, d, s1, imm)
+    def sub_i(self, d, s1, imm): self.imm(0x1d, d, s1, imm)
+    def and_i(self, d, s1, imm): self.imm(0x10, d, s1, imm)
+    def mask_i(self, d, s1, imm): self.imm(0x12, d, s1, imm)
+    def xor_i(self, d, s1, imm): self.imm(0x14, d, s1, imm)
+    def or_i(self, d, s1, imm): self.imm(0x16, d, s1, imm)
+    def or_u(self, d, s1, imm): self.imm(0x17, d, s1, imm)
+    def and_u(self, d, s1, imm): self.imm(0x11, d, s1, imm)
+    def mask_u(self, d, s1, imm): self.imm(0x13, d, s1, imm)
+    def xor_u(self, d, s1, imm): self.imm(0x15, d, s1, imm)
+    def mul_i(self, d, s1, imm): self.imm(0x1b, d, s1, imm)
+    def div_i(self, d, s1, imm): self.imm(0x1e, d, s1, imm)
+    def divu_i(self, d, s1, imm): self.imm(0x1a, d, s1, imm)
+    def cmp_i(self, d, s1, imm): self.imm(0x1f, d, s1, imm)
+
+    # three registers, optionally scaled
+    def ld(self, d, s1, s2, scaled=0): self.triadic(0x05, d, s1, s2, scaled)
+    def st(self, d, s1, s2, scaled=0): self.triadic(0x09, d, s1, s2, scaled)
+    def lda(self, d, s1, s2, scaled=0): self.triadic(0x0d, d, s1, s2, scaled)
+    def add(self, d, s1, s2): self.triadic(0x1c, d, s1, s2)
+    def sub(self, d, s1, s2): self.triadic(0x1d, d, s1, s2)
+    def mul(self, d, s1, s2): self.triadic(0x1b, d, s1, s2)
+    def div(self, d, s1, s2): self.triadic(0x1e, d, s1, s2)
+    def divu(self, d, s1, s2): self.triadic(0x1a, d, s1, s2)
+    def and_(self, d, s1, s2): self.triadic(0x10, d, s1, s2)
+    def xor(self, d, s1, s2): self.triadic(0x14, d, s1, s2)
+    def or_(self, d, s1, s2): self.triadic(0x16, d, s1, s2)
+    def and_c(self, d, s1, s2): self.triadic(0x11, d, s1, s2)
+    def xor_c(self, d, s1, s2): self.triadic(0x15, d, s1, s2)
+    def or_c(self, d, s1, s2): self.triadic(0x17, d, s1, s2)
+    def cmp(self, d, s1, s2): self.triadic(0x1f, d, s1, s2)
+    def jmp(self, s2): self.triadic(0x30, 0, 0, s2)
+    def jsr(self, s2): self.triadic(0x32, 0, 0, s2)
+
+    # SFU1 floating point, all operands single precision
+    def fp(self, fop, d, s1, s2):
+        word = (0x21 << 26) | (d << 21) | (s1 << 16) | (fop << 11) | s2
+        self.emit(lambda labels, pc: word)
+
+    def fmul(self, d, s1, s2): self.fp(0x00, d, s1, s2)
+    def fadd(self, d, s1, s2): self.fp(0x05, d, s1, s2)
+    def fsub(self, d, s1, s2): self.fp(0x06, d, s1, s2)
+    def fdiv(self, d, s1, s2): self.fp(0x0e, d, s1, s2)
+    def flt(self, d, s2): self.fp(0x04, d, 0, s2)
+    def int_(self, d, s2): self.fp(0x09, d, 0, s2)
+
+    def ext(self, d, s1, n): self.bitfield(0x24, d, s1, n)
+    def extu(self, d, s1, n): self.bitfield(0x26, d, s1, n)
+    def mak(self, d, s1, n): self.bitfield(0x28, d, s1, n)
+    def rot(self, d, s1, n): self.bitfield(0x2a, d, s1, n)
+
+    def br(self, target, op1=0x30):
+        def enc(labels, pc):
+            disp = (labels[target] - pc) >> 2
+            assert disp != 0
+            return (op1 << 26) | (disp & 0x03ffffff)
+        self.emit(enc)
+
+    def bsr(self, target): self.br(target, 0x31)
+
+    def bcnd(self, cond, s1, target):
+        def enc(labels, pc):
+            disp = (labels[target] - pc) >> 2
+            assert disp != 0 and -0x8000 <= disp < 0x8000
+            return (0x3a << 26) | (COND[cond] << 21) | (s1 << 16) \
+                | (disp & 0xffff)
+        self.emit(enc)
+
+    def bb(self, op1, bit, s1, target):
+        def enc(labels, pc):
+            disp = (labels[target] - pc) >> 2
+            assert disp != 0 and -0x8000 <= disp < 0x8000
+            return (op1 << 26) | (bit << 21) | (s1 << 16) | (disp & 0xffff)
+        self.emit(enc)
+
+    def bb0(self, bit, s1, target): self.bb(0x34, bit, s1, target)
+    def bb1(self, bit, s1, target): self.bb(0x36, bit, s1, target)
+
+    def halt(self):
+        self.emit(lambda labels, pc: 0)
+
+    def li(self, d, value):
+        """load a 32-bit constant in one or two instructions"""
+        value &= MASK
+        if value <= 0xffff:
+            self.add_i(d, 0, value)
+            return
+        self.or_u(d, 0, value >> 16)
+        if value & 0xffff:
+            self.or_i(d, d, value & 0xffff)
+
+    def words(self):
+        pc = 0
+        for item in self.items:
+            if isinstance(item, str):
+                self.labels[item] = pc
+            else:
+                pc += 4
+        words, pc = [], 0
+        for item in self.items:
+            if not isinstance(item, str):
+                words.append(item(self.labels, pc) & MASK)
+                pc += 4
+        assert len(words) <= INPUT_WORD_LIMIT, len(words)
+        return words
+
+
+# --- shared code fragments ----------------------------------------------
+
+def lcg(x):
+    return (5 * x + 12345) & MASK
+
+
+def rot1(c):
+    return ((c >> 1) | (c << 31)) & MASK
+
+
+def rotsum(values):
+    c = 0
+    for v in values:
+        c = (rot1(c) + v) & MASK
+    return c
+
+
+def emit_lcg(p, x, t):
+    """x = 5 * x + 12345, using t as a scratch register"""
+    p.mak(t, x, 2)
+    p.add(x, t, x)
+    p.add_i(x, x, 12345)
+
+
+def emit_fill(p, name, base, n, shift, x, t, v, i):
+    """base[0 .. n-1] = lcg values >> shift, x holds the generator state"""
+    p.add_i(i, n, 0)
+    p.add_i(v, base, 0)
+    p.label(name)
+    emit_lcg(p, x, t)
+    p.extu(t, x, shift)
+    p.st_i(t, v, 0)
+    p.add_i(v, v, 4)
+    p.sub_i(i, i, 1)
+    p.bcnd("ne0", i, name)
+
+
+def emit_rotsum(p, name, base, n, v, i, t):
+    """r2 = rotsum of base[0 .. n-1]"""
+    p.add_i(2, 0, 0)
+    p.add_i(i, n, 0)
+    p.add_i(v, base, 0)
+    p.label(name)
+    p.ld_i(t, v, 0)
+    p.rot(2, 2, 1)
+    p.add(2, 2, t)
+    p.add_i(v, v, 4)
+    p.sub_i(i, i, 1)
+    p.bcnd("ne0", i, name)
+
+
+def lcg_values(n, shift):
+    x, out = 1, []
+    for _ in range(n):
+        x = lcg(x)
+        out.append(x >> shift)
+    return out
+
+
+def log2(n):
+    k = n.bit_length() - 1
+    if n < 4 or (1 << k) != n:
+        sys.exit("N must be a power of two >= 4")
+    return k
+
+
+# --- benchmarks ------------------------------------------------------------
+#
+# each returns ( program, expected r2, highest byte address used )
+
+def memset(n, reps):
+    p = Program()
+    p.li(10, DATA)
+    p.li(11, n)
+    p.li(12, reps)
+    p.li(13, 0x5a5a0000)
+    p.label("rep")
+    p.add_i(4, 10, 0)
+    p.add_i(5, 11, 0)
+    p.label("fill")
+    p.st_i(13, 4, 0)
+    p.add_i(4, 4, 4)
+    p.sub_i(5, 5, 1)
+    p.bcnd("ne0", 5, "fill")
+    p.add_i(13, 13, 1)
+    p.sub_i(12, 12, 1)
+    p.bcnd("ne0", 12, "rep")
+    emit_rotsum(p, "sum", 10, 11, 4, 5, 6)
+    p.halt()
+    value = (0x5a5a0000 + reps - 1) & MASK
+    return p, rotsum([value] * n), DATA + 4 * n
+
+
+def memcpy(n, reps):
+    src, dst = DATA, DATA + 4 * n
+    p = Program()
+    p.li(10, src)
+    p.li(11, dst)
+    p.li(12, n)
+    p.li(13, reps)
+    p.add_i(20, 0, 1)
+    emit_fill(p, "init", 10, 12, 0, 20, 6, 4, 5)
+    p.label("rep")
+    p.add_i(3, 12, 0)
+    p.label("copy")
+    p.sub_i(3, 3, 1)
+    p.ld(6, 10, 3, scaled=1)
+    p.st(6, 11, 3, scaled=1)
+    p.bcnd("ne0", 3, "copy")
+    p.sub_i(13, 13, 1)
+    p.bcnd("ne0", 13, "rep")
+    emit_rotsum(p, "sum", 11, 12, 4, 5, 6)
+    p.halt()
+    return p, rotsum(lcg_values(n, 0)), dst + 4 * n
+
+
+def matmul(n, reps):
+    a, b, c = DATA, DATA + 4 * n * n, DATA + 8 * n * n
+    p = Program()
+    p.li(10, a)
+    p.li(11, b)
+    p.li(12, c)
+    p.li(13, n)
+    p.li(14, 4 * n)          # row pitch in bytes
+    p.li(15, reps)
+    p.li(16, n * n)
+    p.add_i(20, 0, 1)
+    emit_fill(p, "init_a", 10, 16, 28, 20, 6, 4, 5)
+    emit_fill(p, "init_b", 11, 16, 28, 20, 6, 4, 5)
+    p.label("rep")
+    p.add_i(17, 10, 0)       # a row
+    p.add_i(18, 12, 0)       # c element
+    p.add_i(21, 13, 0)       # i count
+    p.label("row")
+    p.add_i(19, 11, 0)       # b column
+    p.add_i(22, 13, 0)       # j count
+    p.label("col")
+    p.add_i(7, 0, 0)         # acc
+    p.add_i(8, 17, 0)        # pa
+    p.add_i(9, 19, 0)        # pb
+    p.add_i(23, 13, 0)       # k count
+    p.label("dot")
+    p.ld_i(24, 8, 0)
+    p.ld_i(25, 9, 0)
+    p.mul(26, 24, 25)
+    p.add(7, 7, 26)
+    p.add_i(8, 8, 4)
+    p.add(9, 9, 14)
+    p.sub_i(23, 23, 1)
+    p.bcnd("ne0", 23, "dot")
+    p.st_i(7, 18, 0)
+    p.add_i(18, 18, 4)
+    p.add_i(19, 19, 4)
+    p.sub_i(22, 22, 1)
+    p.bcnd("ne0", 22, "col")
+    p.add(17, 17, 14)
+    p.sub_i(21, 21, 1)
+    p.bcnd("ne0", 21, "row")
+    p.sub_i(15, 15, 1)
+    p.bcnd("ne0", 15, "rep")
+    emit_rotsum(p, "sum", 12, 16, 4, 5, 6)
+    p.halt()
+
+    values = lcg_values(2 * n * n, 28)
+    ma, mb = values[:n * n], values[n * n:]
+    mc = []
+    for i in range(n):
+        row = ma[i * n:(i + 1) * n]
+        for j in range(n):
+            mc.append(sum(row[k] * mb[k * n + j] for k in range(n)) & MASK)
+    return p, rotsum(mc), c + 4 * n * n
+
+
+def linked_list(n, reps):
+    """node i is at DATA + 8 i and holds ( next node address, value );
+    the successor of node i is node ( 5 i + 1 ) mod n, a single cycle
+    through all nodes when n is a power of two"""
+    k = log2(n)
+    p = Program()
+    p.li(10, DATA)
+    p.li(11, n)
+    p.li(12, reps)
+    p.add_i(20, 0, 1)
+    p.add_i(3, 0, 0)         # i
+    p.add_i(4, 10, 0)        # node i
+    p.label("build")
+    p.mak(6, 3, 2)
+    p.add(6, 6, 3)
+    p.add_i(6, 6, 1)         # 5 i + 1
+    p.mak(6, 6, 32 - k)
+    p.extu(6, 6, 32 - k)     # mod n
+    p.mak(6, 6, 3)
+    p.add(6, 6, 10)          # its address
+    p.st_i(6, 4, 0)
+    emit_lcg(p, 20, 7)
+    p.st_i(20, 4, 4)
+    p.add_i(4, 4, 8)
+    p.add_i(3, 3, 1)
+    p.sub(7, 3, 11)
+    p.bcnd("ne0", 7, "build")
+    p.add_i(2, 0, 0)
+    p.add_i(4, 10, 0)
+    p.label("rep")
+    p.add_i(5, 11, 0)
+    p.label("walk")
+    p.ld_i(6, 4, 4)
+    p.add(2, 2, 6)
+    p.ld_i(4, 4, 0)
+    p.sub_i(5, 5, 1)
+    p.bcnd("ne0", 5, "walk")
+    p.sub_i(12, 12, 1)
+    p.bcnd("ne0", 12, "rep")
+    p.halt()
+    return p, (reps * sum(lcg_values(n, 0))) & MASK, DATA + 8 * n
+
+
+def bsearch(n, reps):
+    """a[i] = 2 i + 1; each key in [ 0, 2n ) has lower bound key >> 1"""
+    k = log2(n)
+    p = Program()
+    p.li(10, DATA)
+    p.li(11, n)
+    p.li(12, reps)
+    p.add_i(3, 0, 0)
+    p.add_i(4, 10, 0)
+    p.add_i(6, 0, 1)
+    p.label("init")
+    p.st_i(6, 4, 0)
+    p.add_i(6, 6, 2)
+    p.add_i(4, 4, 4)
+    p.add_i(3, 3, 1)
+    p.sub(7, 3, 11)
+    p.bcnd("ne0", 7, "init")
+    p.add_i(2, 0, 0)
+    p.label("rep")
+    p.add_i(20, 0, 1)        # same keys every repetition
+    p.add_i(13, 11, 0)       # query count
+    p.label("query")
+    emit_lcg(p, 20, 7)
+    p.extu(21, 20, 31 - k)   # key in [ 0, 2n )
+    p.add_i(14, 0, 0)        # lo
+    p.add_i(15, 11, 0)       # hi
+    p.label("search")
+    p.sub(7, 15, 14)
+    p.bcnd("le0", 7, "found")
+    p.add(16, 14, 15)
+    p.extu(16, 16, 1)        # mid
+    p.ld(17, 10, 16, scaled=1)
+    p.sub(7, 17, 21)
+    p.bcnd("ge0", 7, "upper")
+    p.add_i(14, 16, 1)       # a[mid] < key: lo = mid + 1
+    p.br("search")
+    p.label("upper")
+    p.add_i(15, 16, 0)       # hi = mid
+    p.br("search")
+    p.label("found")
+    p.add(2, 2, 14)
+    p.sub_i(13, 13, 1)
+    p.bcnd("ne0", 13, "query")
+    p.sub_i(12, 12, 1)
+    p.bcnd("ne0", 12, "rep")
+    p.halt()
+    keys = lcg_values(n, 31 - k)
+    return p, (reps * sum(key >> 1 for key in keys)) & MASK, DATA + 4 * n
+
+
+def histogram(n, reps):
+    data, hist = DATA + 4 * 256, DATA
+    p = Program()
+    p.li(10, data)
+    p.li(11, hist)
+    p.li(12, n)
+    p.li(13, reps)
+    p.add_i(20, 0, 1)
+    emit_fill(p, "init", 10, 12, 0, 20, 6, 4, 5)
+    p.label("rep")
+    p.add_i(4, 10, 0)
+    p.add_i(5, 12, 0)
+    p.label("count")
+    p.ld_i(6, 4, 0)
+    p.extu(6, 6, 24)         # bucket = top byte
+    p.ld(7, 11, 6, scaled=1)
+    p.add_i(7, 7, 1)
+    p.st(7, 11, 6, scaled=1)
+    p.add_i(4, 4, 4)
+    p.sub_i(5, 5, 1)
+    p.bcnd("ne0", 5, "count")
+    p.sub_i(13, 13, 1)
+    p.bcnd("ne0", 13, "rep")
+    p.add_i(14, 0, 256)
+    emit_rotsum(p, "sum", 11, 14, 4, 5, 6)
+    p.halt()
+    counts = [0] * 256
+    for v in lcg_values(n, 24):
+        counts[v] += reps
+    return p, rotsum(c & MASK for c in counts), data + 4 * n
+
+
+def sort(n, reps):
+    p = Program()
+    p.li(10, DATA)
+    p.li(12, DATA + 4)       # a + 1 word, for a[j + 1]
+    p.li(11, n)
+    p.add_i(20, 0, 1)
+    emit_fill(p, "init", 10, 11, 2, 20, 6, 4, 5)   # 30-bit keys
+    p.add_i(3, 0, 1)         # i
+    p.label("outer")
+    p.sub(7, 3, 11)
+    p.bcnd("eq0", 7, "done")
+    p.ld(13, 10, 3, scaled=1)   # key
+    p.sub_i(4, 3, 1)         # j
+    p.label("inner")
+    p.bcnd("lt0", 4, "place")
+    p.ld(14, 10, 4, scaled=1)
+    p.sub(7, 14, 13)
+    p.bcnd("le0", 7, "place")
+    p.st(14, 12, 4, scaled=1)
+    p.sub_i(4, 4, 1)
+    p.br("inner")
+    p.label("place")
+    p.st(13, 12, 4, scaled=1)
+    p.add_i(3, 3, 1)
+    p.br("outer")
+    p.label("done")
+    emit_rotsum(p, "sum", 10, 11, 4, 5, 6)
+    p.halt()
+    return p, rotsum(sorted(lcg_values(n, 2))), DATA + 4 * n
+
+
+BENCHMARKS = {
+    "memset": memset,
+    "memcpy": memcpy,
+    "matmul": matmul,
+    "list": linked_list,
+    "bsearch": bsearch,
+    "histogram": histogram,
+    "sort": sort,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("name", choices=sorted(BENCHMARKS))
+    parser.add_argument("-n", type=int, default=1024, help="problem size")
+    parser.add_argument("-r", "--reps", type=int, default=1,
+                        help="repetitions")
+    parser.add_argument("--expect", action="store_true",
+                        help="print the expected r2 and memory size")
+    args = parser.parse_args()
+    if args.n < 1 or args.reps < 1:
+        sys.exit("N and REPS must be positive")
+
+    program, checksum, top = BENCHMARKS[args.name](args.n, args.reps)
+    words = program.words()
+    if args.expect:
+        print("r2 0x%08x" % checksum)
+        print("mem_mib %d" % max(1, (top + (1 << 20) - 1) >> 20))
+    else:
+        for w in words:
+            print("%08x" % w)
+
+
+if __name__ == "__main__":
+    main()
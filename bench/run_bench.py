@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Run the MC88100 benchmark suite and check every checksum.
+
+    run_bench.py --sim PATH [--size small|medium|large] [--csv FILE]
+                 [--sim-args ARGS] [NAME ...]
+
+Each benchmark is generated with mkbench.py at the chosen size, run with
+--stats-format=json, and its r2 is compared with the reference
+checksum. The report gives simulated instructions, host seconds and
+MIPS for each run. The exit status is non-zero if any checksum is
+wrong.
+
+The sizes are roughly
+
+    small    a few million instructions each, under 1 MiB of data
+    medium   tens to hundreds of millions of instructions
+    large    billions of instructions and up to 256 MiB of data
+"""
+
+import argparse
+import json
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mkbench  # noqa: E402
+
+# ( N, REPS ) for each benchmark and size
+SIZES = {
+    "small": {
+        "memset": (65536, 16), "memcpy": (65536, 16), "matmul": (32, 4),
+        "list": (65536, 16), "bsearch": (16384, 4), "histogram": (65536, 8),
+        "sort": (2048, 1),
+    },
+    "medium": {
+        "memset": (1 << 20, 32), "memcpy": (1 << 20, 32), "matmul": (128, 2),
+        "list": (1 << 20, 32), "bsearch": (1 << 18, 4),
+        "histogram": (1 << 20, 16), "sort": (8192, 1),
+    },
+    "large": {
+        "memset": (1 << 26, 8), "memcpy": (1 << 25, 8), "matmul": (256, 8),
+        "list": (1 << 24, 32), "bsearch": (1 << 24, 1),
+        "histogram": (1 << 26, 4), "sort": (32768, 1),
+    },
+}
+
+
+def run_one(sim, name, n, reps, extra):
+    program, checksum, top = mkbench.BENCHMARKS[name](n, reps)
+    mib = max(1, (top + (1 << 20) - 1) >> 20)
+    with tempfile.TemporaryFile("w+") as image:
+        image.write("".join("%08x\n" % w for w in program.words()))
+        image.seek(0)
+        out = subprocess.run([sim, "--stats-format=json", "--mem-size",
+                              str(mib)] + extra, stdin=image,
+                             stdout=subprocess.PIPE, check=True, text=True)
+    stats = json.loads(out.stdout)
+    return {
+        "name": name, "n": n, "reps": reps, "mem_mib": mib,
+        "instructions": stats["core"]["inst_fetches"],
+        "seconds": stats["host"]["wall_seconds"],
+        "mips": stats["host"]["mips"],
+        "expected": checksum, "r2": stats["registers"]["r2"],
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--sim", required=True, help="simulator binary")
+    parser.add_argument("--size", choices=sorted(SIZES), default="small")
+    parser.add_argument("--sim-args", default="",
+                        help="extra simulator options, e.g. --self-profile")
+    parser.add_argument("--csv", help="append one row per run to this file")
+    parser.add_argument("names", nargs="*",
+                        help="benchmarks to run (default all)")
+    args = parser.parse_args()
+
+    names = args.names or list(SIZES[args.size])
+    failed = 0
+    rows = []
+    print("%-10s %10s %5s %8s %14s %10s %9s  %s" % (
+        "benchmark", "n", "reps", "mem MiB", "instructions", "seconds",
+        "MIPS", "checksum"))
+    for name in names:
+        n, reps = SIZES[args.size][name]
+        r = run_one(args.sim, name, n, reps, shlex.split(args.sim_args))
+        ok = r["r2"] == r["expected"]
+        failed += not ok
+        rows.append(r)
+        print("%-10s %10d %5d %8d %14d %10.3f %9.2f  %s" % (
+            name, n, reps, r["mem_mib"], r["instructions"], r["seconds"],
+            r["mips"], "ok" if ok else "WRONG r2=0x%08x expected 0x%08x" % (
+                r["r2"], r["expected"])))
+
+    total_inst = sum(r["instructions"] for r in rows)
+    total_sec = sum(r["seconds"] for r in rows)
+    if total_sec > 0:
+        print("%-10s %10s %5s %8s %14d %10.3f %9.2f" % (
+            "total", "", "", "", total_inst, total_sec,
+            total_inst / total_sec / 1e6))
+
+    if args.csv:
+        new = not os.path.exists(args.csv)
+        with open(args.csv, "a") as f:
+            if new:
+                f.write("benchmark,size,n,reps,instructions,seconds,mips,ok\n")
+            for r in rows:
+                f.write("%s,%s,%d,%d,%d,%.6f,%.3f,%d\n" % (
+                    r["name"], args.size, r["n"], r["reps"],
+                    r["instructions"], r["seconds"], r["mips"],
+                    r["r2"] == r["expected"]))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""Check the behaviour that the tc*.in golden outputs do not cover.
+
+    run_cases.py --sim PATH --asm PATH --plugins DIR
+
+Each case assembles a short program with asm88, or takes none, runs
+the simulator with some options, and checks the output. The exit status is
+1 if any case fails and 0 otherwise.
+"""
+
+import argparse
+import json
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+# branches to the next word are taken; four of them, then one that is not
+NEXT_WORD_BRANCHES = """
+        br    1
+        bcnd  always,r0,1
+        or    r2,r0,1
+        bb1   0,r2,1
+        bb0   1,r2,1
+        bcnd  never,r0,1
+        halt
+"""
+
+
+def single(x):
+    return struct.unpack(">I", struct.pack(">f", x))[0]
+
+
+def double(x):
+    return struct.unpack(">II", struct.pack(">d", x))
+
+
+# what the instructions added after the original subset compute, as
+# final register values; the goldens use only the original subset, and
+# the fuzzer only compares the engines with each other
+
+LOGICAL = """
+        or.u  r2,r0,1234
+        or    r2,r2,5678
+        and   r3,r2,ff0f
+        and.u r4,r2,ff0f
+        mask  r5,r2,ff0f
+        mask.u r6,r2,ff0f
+        xor   r7,r2,ffff
+        xor.u r8,r2,ffff
+        or.u  r9,r0,f0f0
+        and   ra,r2,r9
+        and.c rb,r2,r9
+        xor   rc,r2,r9
+        xor.c rd,r2,r9
+        or    re,r2,r9
+        or.c  rf,r2,r9
+        halt
+"""
+LOGICAL_REGS = {2: 0x12345678, 3: 0x12345608, 4: 0x12045678, 5: 0x5608,
+                6: 0x12040000, 7: 0x1234a987, 8: 0xedcb5678, 10: 0x10300000,
+                11: 0x02045678, 12: 0xe2c45678, 13: 0x1d3ba987,
+                14: 0xf2f45678, 15: 0x1f3fffff}
+
+# -7 and 2; div truncates toward zero, and -2^31 / -1 wraps
+MULTIPLY_DIVIDE = """
+        sub   r2,r0,7
+        add   r3,r0,2
+        mul   r4,r2,r3
+        div   r5,r2,r3
+        divu  r6,r2,r3
+        mul   r7,r3,7
+        div   r8,r2,2
+        divu  r9,r2,2
+        or.u  ra,r0,8000
+        sub   rb,r0,1
+        div   rc,ra,rb
+        halt
+"""
+MULTIPLY_DIVIDE_REGS = {4: 0xfffffff2, 5: 0xfffffffd, 6: 0x7ffffffc, 7: 14,
+                        8: 0xfffffffd, 9: 0x7ffffffc, 12: 0x80000000}
+
+SUBROUTINES = """
+        bsr   one
+        or    r3,r0,1
+        or    r4,r0,two
+        jsr   r4
+        halt
+one:    add   r2,r2,1
+        jmp   r1
+two:    add   r2,r2,10
+        jmp   r1
+"""
+SUBROUTINE_REGS = {1: 0x10, 2: 0x11, 3: 1, 4: 0x1c}
+
+# cmp of -7 with 2 is ne, le, lt, hi, hs; of 2 with 2, eq, le, ge, ls, hs
+COMPARE_AND_BIT_BRANCHES = """
+        sub   r2,r0,7
+        add   r3,r0,2
+        cmp   r4,r2,r3
+        cmp   r5,r3,2
+        bb1   lt,r4,t1
+        or    r6,r0,1
+t1:     bb0   eq,r4,t2
+        or    r7,r0,1
+t2:     bb1   eq,r4,t3
+        or    r8,r0,1
+t3:     bb0   2,r5,t4
+        or    r9,r0,1
+t4:     halt
+"""
+COMPARE_REGS = {4: 0x968, 5: 0xaa4, 6: 0, 7: 0, 8: 1, 9: 1}
+
+# 1.5 and 2.0 in r2 and r3, 2.5 in r4, and -7 in r5; int rounds to
+#   nearest even
+FLOATING_POINT = """
+        or.u  r2,r0,3fc0
+        or.u  r3,r0,4000
+        or.u  r4,r0,4020
+        sub   r5,r0,7
+        fadd.sss r6,r2,r3
+        fsub.sss r7,r2,r3
+        fmul.sss r8,r2,r3
+        fdiv.sss r9,r2,r3
+        fadd.dss ra,r2,r3
+        fdiv.ssd rc,r2,ra
+        flt.ss rd,r5
+        int.ss re,r2
+        int.ss rf,r4
+        fmul.ddd r10,ra,ra
+        halt
+"""
+FLOATING_POINT_REGS = {6: single(3.5), 7: single(-0.5), 8: single(3.0),
+                       9: single(0.75), 10: double(3.5)[0],
+                       11: double(3.5)[1], 12: single(1.5 / 3.5),
+                       13: single(-7.0), 14: 2, 15: 2,
+                       16: double(12.25)[0], 17: double(12.25)[1]}
+
+
+def registers(source, regs):
+    """a case that runs source on both engines and checks regs"""
+    def case(run, plugins):
+        for engine in ("switch", "threaded"):
+            out, _, status = run(source, ["--stats-format=json",
+                                          "--engine", engine])
+            if status != 0:
+                return False
+            final = json.loads(out)["registers"]
+            for r, value in regs.items():
+                if final["r%d" % r] & 0xffffffff != value:
+                    return False
+        return True
+    return case
+
+
+def trap(source, message):
+    """a case that runs source on both engines and expects the trap"""
+    def case(run, plugins):
+        for engine in ("switch", "threaded"):
+            out, _, status = run(source, ["--engine", engine])
+            if status == 0 or message not in out:
+                return False
+        return True
+    return case
+
+
+DIVIDE_BY_ZERO = """
+        add   r2,r0,7
+        div   r3,r2,r0
+        halt
+"""
+
+CONVERSION_OVERFLOW = """
+        or.u  r2,r0,4f32
+        int.ss r3,r2
+        halt
+"""
+
+
+def next_word_branches(run, plugins):
+    out, _, _ = run(NEXT_WORD_BRANCHES, ["--plugin", plugins("pipeline")])
+    return ("branches taken      = 4 " in out
+            and "taken branch      = 4\n" in out)
+
+
+def plugin_with_json(run, plugins):
+    out, err, _ = run(NEXT_WORD_BRANCHES, ["--stats-format=json",
+                                           "--plugin", plugins("pipeline")])
+    try:
+        json.loads(out)
+    except ValueError:
+        return False
+    return "pipeline timing" in err
+
+
+def empty_manifest(run, plugins):
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, text in (("empty", ""), ("comments", "# no jobs\n\n")):
+            manifest = os.path.join(tmp, name)
+            with open(manifest, "w") as f:
+                f.write(text)
+            out, _, status = run(None, ["--batch", manifest])
+            try:
+                report = json.loads(out)
+            except ValueError:
+                return False
+            if (status != 0 or report["batch"]["jobs"] != 0
+                    or report["results"]):
+                return False
+    return True
+
+
+CASES = [
+    ("branches to the next word are taken", next_word_branches),
+    ("plugin reports stay out of the json", plugin_with_json),
+    ("an empty manifest is an empty batch", empty_manifest),
+    ("logical operations", registers(LOGICAL, LOGICAL_REGS)),
+    ("multiply and divide", registers(MULTIPLY_DIVIDE, MULTIPLY_DIVIDE_REGS)),
+    ("bsr, jsr and jmp", registers(SUBROUTINES, SUBROUTINE_REGS)),
+    ("cmp, bb0 and bb1", registers(COMPARE_AND_BIT_BRANCHES, COMPARE_REGS)),
+    ("floating point", registers(FLOATING_POINT, FLOATING_POINT_REGS)),
+    ("divide by zero traps", trap(DIVIDE_BY_ZERO,
+                                  "integer divide by zero at 4")),
+    ("int overflow traps", trap(CONVERSION_OVERFLOW,
+                                "integer conversion overflow at 4")),
+]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--sim", required=True, help="simulator binary")
+    parser.add_argument("--asm", required=True, help="asm88 binary")
+    parser.add_argument("--plugins", required=True,
+                        help="directory of the plugin .so files")
+    args = parser.parse_args()
+
+    def run(source, options):
+        program = ""
+        if source is not None:
+            program = subprocess.run([args.asm], input=source, check=True,
+                                     capture_output=True, text=True).stdout
+        proc = subprocess.run([args.sim] + options,
+                              input=program,
+                              capture_output=True, text=True)
+        return proc.stdout, proc.stderr, proc.returncode
+
+    def plugins(name):
+        return os.path.join(args.plugins, name + ".so")
+
+    failures = 0
+    for name, case in CASES:
+        ok = case(run, plugins)
+        failures += not ok
+        print("%-40s %s" % (name, "ok" if ok else "FAIL"))
+    print("%d cases, %d failed" % (len(CASES), failures))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
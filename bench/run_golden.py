@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Check both simulators against the tc*.in / tc*.out golden outputs.
+
+    run_golden.py [--base PATH] [--cache PATH] [--engine NAME=ARGS ...]
+                  [--timing] [--repeats R] [--history FILE]
+                  [--threshold PERCENT]
+
+Every tc*.in in each simulator directory is run in every mode
+(statistics only, -t, and -v) and with every engine. The mode that
+produced a .out file can be seen from its first line. That mode must
+match the .out file exactly. In the other modes, the execution
+statistics at the end must match those of the .out file, since tracing
+must not change what is executed. A test without a .out file (tc1) must
+give the same statistics in every mode and engine.
+
+Without --base and --cache, both sim.c files are compiled with the
+library in lib/ using $CC (default cc) -O2 into a temporary directory.
+
+--engine names an engine and the simulator options that select it. The
+default is the switch engine, the threaded engine (--engine threaded),
+and the two in lockstep (--lockstep).
+
+Output is streamed and only its end is kept, since -v on tc8 writes
+about 2 GB.
+
+With --timing, each run is timed R times (default 5), keeping the
+fastest; a run that takes more than a second is timed once. The times
+are appended to the CSV history file (default build/golden_history.csv).
+A run is flagged SLOWER when its time exceeds the median of its last
+five recorded times by more than --threshold percent (default 25). Runs
+faster than 20 ms, and runs with fewer than three recorded times, are
+not compared, since their times are mostly noise. Without --timing each
+run is done once and the times are only printed.
+
+The exit status is 1 if any output differs, 2 if only slowdowns were
+flagged, and 0 otherwise.
+"""
+
+import argparse
+import csv
+import glob
+import os
+import shlex
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DIRS = {
+    "base": "MC88100 RISC Instruction Simulator",
+    "cache": "MC88100 Simulator with Cache",
+}
+MODES = {"stats": [], "trace": ["-t"], "verbose": ["-v"]}
+DEFAULT_ENGINES = ["switch=", "threaded=--engine threaded",
+                   "lockstep=--lockstep"]
+HISTORY_WINDOW = 5
+MIN_HISTORY = 3        # recorded times before a run is compared
+MIN_SECONDS = 0.02     # shorter runs are not compared
+TAIL_BYTES = 1 << 16   # more than the statistics at the end of a run
+LONG_RUN = 1.0         # seconds; such a run is not repeated
+
+
+def golden_mode(text):
+    if text.startswith("reading words"):
+        return "verbose"
+    if text.startswith("instruction trace:"):
+        return "trace"
+    return "stats"
+
+
+def statistics_part(text):
+    at = text.find("execution statistics")
+    return text[at:] if at >= 0 else text
+
+
+def build(tmp):
+    cc = os.environ.get("CC", "cc")
+    lib = sorted(glob.glob(os.path.join(ROOT, "lib", "*.c")))
+    paths = {}
+    for sim, d in DIRS.items():
+        paths[sim] = os.path.join(tmp, "sim-" + sim)
+        subprocess.run([cc, "-O2", "-o", paths[sim],
+                        os.path.join(ROOT, d, "sim.c")] + lib + ["-ldl", "-pthread"],
+                       check=True)
+    return paths
+
+
+def run(binary, args, test, golden, repeats):
+    """returns ( equals golden, statistics part, fastest seconds )
+
+    the output is streamed, since -v on a long test writes gigabytes;
+    only the tail is kept, and it is compared with golden as it arrives
+    """
+    best = None
+    for _ in range(repeats):
+        with open(test) as f:
+            start = time.perf_counter()
+            proc = subprocess.Popen([binary] + args, stdin=f,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.DEVNULL)
+            tail, offset, same = b"", 0, golden is not None
+            for chunk in iter(lambda: proc.stdout.read(1 << 20), b""):
+                if same:
+                    same = golden[offset:offset + len(chunk)] == chunk
+                offset += len(chunk)
+                tail = (tail + chunk)[-TAIL_BYTES:]
+            proc.wait()
+            elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+        if elapsed > LONG_RUN:
+            break
+    same = same and offset == len(golden)
+    return same, statistics_part(tail.decode(errors="replace")), best
+
+
+def load_history(path):
+    past = {}
+    if os.path.exists(path):
+        with open(path) as f:
+            for row in csv.DictReader(f):
+                key = (row["sim"], row["test"], row["mode"], row["engine"])
+                past.setdefault(key, []).append(float(row["seconds"]))
+    return past
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--base", help="base simulator binary")
+    parser.add_argument("--cache", help="cache simulator binary")
+    parser.add_argument("--engine", action="append", metavar="NAME=ARGS",
+                        help="engine name and the options that select it")
+    parser.add_argument("--timing", action="store_true",
+                        help="record the times and flag slowdowns")
+    parser.add_argument("--repeats", type=int, default=5)
+    parser.add_argument("--history",
+                        default=os.path.join(ROOT, "build",
+                                             "golden_history.csv"))
+    parser.add_argument("--threshold", type=float, default=25.0,
+                        help="slowdown in percent that is flagged")
+    args = parser.parse_args()
+
+    engines = []
+    for e in args.engine or DEFAULT_ENGINES:
+        name, _, options = e.partition("=")
+        engines.append((name, shlex.split(options)))
+
+    tmp = tempfile.TemporaryDirectory()
+    binaries = {"base": args.base, "cache": args.cache}
+    if not all(binaries.values()):
+        built = build(tmp.name)
+        for sim in binaries:
+            binaries[sim] = binaries[sim] or built[sim]
+
+    past = load_history(args.history) if args.timing else {}
+    repeats = args.repeats if args.timing else 1
+    stamp = time.strftime("%Y-%m-%dT%H:%M:%S")
+    rows, failures, slowdowns = [], 0, 0
+
+    for sim, d in DIRS.items():
+        for test in sorted(glob.glob(os.path.join(ROOT, d, "tc*.in"))):
+            name = os.path.basename(test)[:-3]
+            golden_path = test[:-3] + ".out"
+            golden = None
+            if os.path.exists(golden_path):
+                with open(golden_path, "rb") as f:
+                    golden = f.read()
+            reference = None
+            if golden is not None:
+                reference = statistics_part(golden.decode())
+                mode_of_golden = golden_mode(golden.decode())
+
+            for engine, options in engines:
+                for mode, mode_args in MODES.items():
+                    check = golden is not None and mode == mode_of_golden
+                    same, stats, seconds = run(
+                        binaries[sim], mode_args + options, test,
+                        golden if check else None, repeats)
+                    if check:
+                        ok, what = same, "golden"
+                    else:
+                        if reference is None:
+                            reference = stats
+                        ok, what = (stats == reference), "stats"
+
+                    key = (sim, name, mode, engine)
+                    history = past.get(key, [])[-HISTORY_WINDOW:]
+                    slower = ""
+                    if (len(history) >= MIN_HISTORY
+                            and seconds >= MIN_SECONDS):
+                        typical = statistics.median(history)
+                        change = 100.0 * (seconds - typical) / typical
+                        if change > args.threshold:
+                            slower = "  SLOWER by %.0f%%" % change
+                            slowdowns += 1
+                    failures += not ok
+                    rows.append((stamp, sim, name, mode, engine, seconds, ok))
+                    print("%-5s %-4s %-7s %-8s %-6s %-4s %8.2fms%s" % (
+                        sim, name, mode, engine, what,
+                        "ok" if ok else "FAIL", 1e3 * seconds, slower))
+
+    if args.timing:
+        os.makedirs(os.path.dirname(os.path.abspath(args.history)),
+                    exist_ok=True)
+        new = not os.path.exists(args.history)
+        with open(args.history, "a") as f:
+            if new:
+                f.write("time,sim,test,mode,engine,seconds,ok\n")
+            for stamp, sim, name, mode, engine, seconds, ok in rows:
+                f.write("%s,%s,%s,%s,%s,%.6f,%d\n" % (
+                    stamp, sim, name, mode, engine, seconds, ok))
+
+    print("%d runs, %d failed, %d flagged slower" % (
+        len(rows), failures, slowdowns))
+    sys.exit(1 if failures else 2 if slowdowns else 0)
+
+
+if __name__ == "__main__":
+    main()
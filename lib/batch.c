@@ -0,0 +1,398 @@
+/* batch mode: --batch FILE runs every job of a manifest in this process
+ *
+ * a manifest has one job per line, a program file followed by options
+ *
+ *   # program          options
+ *   tc6.in
+ *   tc7.in             -p --engine threaded
+ *   ../bench/sort.in   --mem-size 4 --no-cache
+ *
+ * the options are those of the command line, which supplies the
+ *   defaults, plus --cache and --no-cache; options that write more
+ *   than the statistics (-t, -v, --interval, --plugin, --stats-format)
+ *   are not allowed, see parse_job_options(); a relative program name
+ *   is relative to the manifest, and each distinct program is read
+ *   only once; a manifest with no jobs gives a report with no results
+ *
+ * each job runs in its own context on a pool of threads; the jobs are
+ *   dealt out in contiguous blocks, one per thread, and a thread that
+ *   finishes its own block steals single jobs from the far end of the
+ *   other blocks; every job writes its json report to a memory stream,
+ *   and the reports are merged in manifest order once all jobs are done
+ */
+
+#define _GNU_SOURCE   /* open_memstream, getline */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sim88_internal.h"
+
+struct program {
+  char *path;
+  int binary;
+  unsigned int *words,
+               count;
+};
+
+struct job {
+  int line;
+  char *text,                   /* the manifest line, which options use */
+       *options;                /* the options as written               */
+  struct sim88_config config;
+  int binary,
+      program;                  /* index in the programs read */
+  char *result;                 /* the report or the error messages */
+  size_t size;
+  int failed;
+  unsigned long long inst_fetches;
+};
+
+/* the unstarted jobs of one thread, first to last - 1 */
+
+struct block {
+  pthread_mutex_t lock;
+  int first, last;
+};
+
+struct pool {
+  struct job *jobs;
+  struct program *programs;
+  struct block *blocks;
+  int threads;
+  unsigned long long steals;
+  pthread_mutex_t steals_lock;
+};
+
+struct worker {
+  struct pool *pool;
+  int id;
+};
+
+/* the index of a program, which is read the first time; -1 after */
+/*   a message                                                     */
+
+static int find_program( struct program **programs, int *num, int *max,
+                         const char *path, int binary ){
+  struct program *p;
+  FILE *in;
+
+  for( int i = 0; i < *num; i++ ){
+    p = &(*programs)[ i ];
+    if( ( p->binary == binary ) && ( strcmp( p->path, path ) == 0 ) ) return i;
+  }
+  if( *num == *max ){
+    *max = *max ? 2 * *max : 16;
+    *programs = realloc( *programs, *max * sizeof( struct program ) );
+    if( *programs == NULL ){
+      printf( "cannot allocate the batch\n" );
+      return -1;
+    }
+  }
+  in = fopen( path, binary ? "rb" : "r" );
+  if( in == NULL ){
+    printf( "cannot open program %s\n", path );
+    return -1;
+  }
+  p = &(*programs)[ *num ];
+  p->path = strdup( path );
+  p->binary = binary;
+  if( read_program( in, binary, &p->words, &p->count ) != 0 ){
+    printf( "cannot read program %s\n", path );
+    fclose( in );
+    return -1;
+  }
+  fclose( in );
+  return (*num)++;
+}
+
+/* split job->text into words and parse the options; the number of */
+/*   words, so 0 for a blank line, or -1 after a message             */
+
+static int parse_job( struct job *job, const struct sim88_config *defaults,
+                      int binary, char **words ){
+  struct cli_options o = { .config = *defaults, .binary_input = binary };
+  char *comment = strchr( job->text, '#' ),
+       *word;
+  int argc = 0;
+  size_t size;
+
+  if( comment ) *comment = '\0';
+  for( word = strtok( job->text, " \t\r\n" ); word; word = strtok( NULL, " \t\r\n" ) ){
+    words[ argc++ ] = word;
+  }
+  if( argc == 0 ) return 0;
+
+  if( parse_job_options( argc, words, &o ) != 0 ) return -1;
+
+  /* the options as written, for the results */
+  size = 1;
+  for( int i = 1; i < argc; i++ ) size += strlen( words[ i ] ) + 1;
+  job->options = calloc( size, 1 );
+  for( int i = 1; i < argc; i++ ){
+    if( i > 1 ) strcat( job->options, " " );
+    strcat( job->options, words[ i ] );
+  }
+  job->config = o.config;
+  job->binary = o.binary_input;
+  return argc;
+}
+
+static void free_jobs( struct job *jobs, int num_jobs ){
+  for( int i = 0; i < num_jobs; i++ ){
+    free( jobs[ i ].text );
+    free( jobs[ i ].options );
+    free( jobs[ i ].result );
+  }
+  free( jobs );
+}
+
+/* the jobs of a manifest, or NULL after a message */
+
+static struct job *read_manifest( const char *manifest,
+                                  const struct sim88_config *defaults, int binary,
+                                  int *num_jobs, struct program **programs,
+                                  int *num_programs ){
+  FILE *in = fopen( manifest, "r" );
+  const char *slash = strrchr( manifest, '/' );
+  int dir_length = slash ? (int)( slash - manifest + 1 ) : 0,
+      max_jobs = 0,
+      max_programs = 0,
+      line = 0,
+      argc;
+  char *text = NULL,
+       **words = NULL,
+       *path;
+  size_t text_size = 0;
+  ssize_t length;
+  struct job *jobs = NULL,
+             *job;
+
+  if( in == NULL ){
+    printf( "cannot open manifest %s\n", manifest );
+    return NULL;
+  }
+  *num_jobs = 0;
+  while( ( length = getline( &text, &text_size, in ) ) >= 0 ){
+    line++;
+    if( *num_jobs == max_jobs ){
+      max_jobs = max_jobs ? 2 * max_jobs : 64;
+      jobs = realloc( jobs, max_jobs * sizeof( struct job ) );
+    }
+    words = realloc( words, ( length / 2 + 2 ) * sizeof( char * ) );
+    if( ( jobs == NULL ) || ( words == NULL ) ){
+      printf( "cannot allocate the batch\n" );
+      goto fail;
+    }
+    job = &jobs[ *num_jobs ];
+    memset( job, 0, sizeof( struct job ) );
+    job->line = line;
+    job->text = strdup( text );
+    (*num_jobs)++;
+    argc = parse_job( job, defaults, binary, words );
+    if( argc == 0 ){
+      free( job->text );
+      (*num_jobs)--;
+      continue;
+    }
+    if( argc < 0 ) goto bad_line;
+
+    path = malloc( dir_length + strlen( words[ 0 ] ) + 1 );
+    if( words[ 0 ][ 0 ] == '/' ) strcpy( path, words[ 0 ] );
+    else sprintf( path, "%.*s%s", dir_length, manifest, words[ 0 ] );
+    job->program = find_program( programs, num_programs, &max_programs, path,
+                                 job->binary );
+    free( path );
+    if( job->program < 0 ) goto bad_line;
+  }
+  if( jobs == NULL ) jobs = malloc( sizeof( struct job ) );  /* an empty file */
+  if( jobs == NULL ){
+    printf( "cannot allocate the batch\n" );
+    goto fail;
+  }
+  free( text );
+  free( words );
+  fclose( in );
+  return jobs;
+
+bad_line:
+  printf( "in %s line %d\n", manifest, line );
+fail:
+  free_jobs( jobs, *num_jobs );
+  free( text );
+  free( words );
+  fclose( in );
+  return NULL;
+}
+
+static void run_job( struct job *job, const struct program *program ){
+  struct sim88 *s;
+  FILE *out = open_memstream( &job->result, &job->size );
+
+  if( out == NULL ){
+    job->failed = 1;
+    return;
+  }
+  job->config.out = out;
+  s = sim88_new( &job->config );
+  if( ( s == NULL )
+      || sim88_load_words( s, program->words, program->count )
+      || sim88_run( s ) ){
+    job->failed = 1;
+  }else{
+    sim88_report( s, SIM88_STATS_JSON );
+  }
+  if( s ) job->inst_fetches = s->inst_fetches;
+  sim88_free( s );
+  fclose( out );
+}
+
+/* the next job of a thread, from its own block or stolen; -1 when */
+/*   every block is empty                                          */
+
+static int next_job( struct pool *pool, int id ){
+  struct block *own = &pool->blocks[ id ];
+  int job = -1;
+
+  pthread_mutex_lock( &own->lock );
+  if( own->first < own->last ) job = own->first++;
+  pthread_mutex_unlock( &own->lock );
+  if( job >= 0 ) return job;
+
+  for( int i = 1; ( i < pool->threads ) && ( job < 0 ); i++ ){
+    struct block *victim = &pool->blocks[ ( id + i ) % pool->threads ];
+    pthread_mutex_lock( &victim->lock );
+    if( victim->first < victim->last ) job = --victim->last;
+    pthread_mutex_unlock( &victim->lock );
+  }
+  if( job >= 0 ){
+    pthread_mutex_lock( &pool->steals_lock );
+    pool->steals++;
+    pthread_mutex_unlock( &pool->steals_lock );
+  }
+  return job;
+}
+
+static void *worker( void *arg ){
+  struct worker *w = arg;
+  int job;
+
+  while( ( job = next_job( w->pool, w->id ) ) >= 0 ){
+    struct job *j = &w->pool->jobs[ job ];
+    run_job( j, &w->pool->programs[ j->program ] );
+  }
+  return NULL;
+}
+
+static void json_string( FILE *out, const char *s, size_t length ){
+  fputc( '"', out );
+  for( size_t i = 0; i < length; i++ ){
+    unsigned char c = s[ i ];
+    if( ( c == '"' ) || ( c == '\\' ) ) fprintf( out, "\\%c", c );
+    else if( c == '\n' ) fprintf( out, "\\n" );
+    else if( c < 0x20 ) fprintf( out, "\\u%04x", c );
+    else fputc( c, out );
+  }
+  fputc( '"', out );
+}
+
+/* a job's report, indented to its place in the results */
+
+static void json_report( FILE *out, const char *report, size_t size ){
+  while( size && ( report[ size - 1 ] == '\n' ) ) size--;
+  for( size_t i = 0; i < size; i++ ){
+    fputc( report[ i ], out );
+    if( report[ i ] == '\n' ) fprintf( out, "      " );
+  }
+}
+
+int sim88_batch( const char *manifest, const struct sim88_config *defaults,
+                 int binary, int threads, FILE *out ){
+  struct pool pool = { .steals = 0 };
+  struct worker *workers;
+  pthread_t *ids;
+  struct timespec start, end;
+  unsigned long long inst_fetches = 0;
+  int num_jobs, num_programs = 0, failed = 0;
+  double seconds;
+
+  pool.jobs = read_manifest( manifest, defaults, binary, &num_jobs,
+                             &pool.programs, &num_programs );
+  if( pool.jobs == NULL ) return -1;
+
+  if( threads < 1 ) threads = sysconf( _SC_NPROCESSORS_ONLN );
+  if( threads < 1 ) threads = 1;
+  if( threads > num_jobs ) threads = num_jobs ? num_jobs : 1;
+  pool.threads = threads;
+  pool.blocks = calloc( threads, sizeof( struct block ) );
+  workers = calloc( threads, sizeof( struct worker ) );
+  ids = calloc( threads, sizeof( pthread_t ) );
+  if( ( pool.blocks == NULL ) || ( workers == NULL ) || ( ids == NULL ) ){
+    printf( "cannot allocate the batch\n" );
+    return -1;
+  }
+  pthread_mutex_init( &pool.steals_lock, NULL );
+  for( int i = 0; i < threads; i++ ){
+    pthread_mutex_init( &pool.blocks[ i ].lock, NULL );
+    pool.blocks[ i ].first = (long long)num_jobs * i / threads;
+    pool.blocks[ i ].last = (long long)num_jobs * ( i + 1 ) / threads;
+    workers[ i ].pool = &pool;
+    workers[ i ].id = i;
+  }
+
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for( int i = 1; i < threads; i++ ){
+    if( pthread_create( &ids[ i ], NULL, worker, &workers[ i ] ) != 0 ){
+      printf( "cannot start batch thread %d\n", i );
+      exit( -1 );
+    }
+  }
+  worker( &workers[ 0 ] );
+  for( int i = 1; i < threads; i++ ) pthread_join( ids[ i ], NULL );
+  clock_gettime( CLOCK_MONOTONIC, &end );
+  seconds = ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) * 1e-9;
+
+  for( int i = 0; i < num_jobs; i++ ){
+    failed += pool.jobs[ i ].failed;
+    inst_fetches += pool.jobs[ i ].inst_fetches;
+  }
+
+  fprintf( out, "{\n  \"batch\": {\n    \"manifest\": " );
+  json_string( out, manifest, strlen( manifest ) );
+  fprintf( out, ",\n    \"jobs\": %d,\n    \"programs\": %d,\n"
+                "    \"threads\": %d,\n    \"steals\": %llu,\n"
+                "    \"failed\": %d,\n    \"inst_fetches\": %llu,\n"
+                "    \"wall_seconds\": %.6f,\n    \"mips\": %.6f\n  },\n"
+                "  \"results\": [",
+    num_jobs, num_programs, threads, pool.steals, failed, inst_fetches,
+    seconds, ( seconds > 0.0 ) ? inst_fetches / seconds / 1e6 : 0.0 );
+  for( int i = 0; i < num_jobs; i++ ){
+    struct job *job = &pool.jobs[ i ];
+    fprintf( out, "%s\n    {\n      \"job\": %d,\n      \"line\": %d,\n"
+                  "      \"program\": ", i ? "," : "", i, job->line );
+    json_string( out, pool.programs[ job->program ].path,
+      strlen( pool.programs[ job->program ].path ) );
+    fprintf( out, ",\n      \"options\": " );
+    json_string( out, job->options, strlen( job->options ) );
+    if( job->failed ){
+      fprintf( out, ",\n      \"status\": \"failed\",\n      \"error\": " );
+      json_string( out, job->result ? job->result : "", job->size );
+    }else{
+      fprintf( out, ",\n      \"status\": \"ok\",\n      \"stats\": " );
+      json_report( out, job->result, job->size );
+    }
+    fprintf( out, "\n    }" );
+  }
+  fprintf( out, "\n  ]\n}\n" );
+
+  free_jobs( pool.jobs, num_jobs );
+  for( int i = 0; i < num_programs; i++ ){
+    free( pool.programs[ i ].path );
+    free( pool.programs[ i ].words );
+  }
+  free( pool.programs );
+  free( pool.blocks );
+  free( workers );
+  free( ids );
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/* Cache statistics for a 1 KiB, 2-way set associative, write-back
+ *   data cache with 8 bytes/line and LRU replacement
+ *
+ * note that this simulation does not include the contents of the
+ *   cache lines - instead, the cache directory bits (valid, dirty,
+ *   and tag) and the per-set replacement state are used to determine
+ *   the hit, miss, and write-back counts based on the addresses used
+ *   to access the cache and the types of accesses (reads or writes)
+ *
+ * routines
+ *
+ *   void cache_init( struct cache *c );
+ *   unsigned int cache_access( struct cache *c, unsigned int address,
+ *                              unsigned int type );
+ *   void cache_stats( const struct cache *c, FILE *out );
+ *
+ * for each call to cache_access() address is the byte address, and
+ *   type is either read (=0) or write (=1); the return value is 1 on
+ *   a miss and 0 on a hit so that callers can attribute misses
+ *
+ * the directory, replacement state, and counters are kept in a struct
+ *   cache, so that a second simulation can use its own cache
+ *
+ *
+ * 1 KiB two-way set-associative cache, 8 bytes/line
+ *   => 128 total lines, 2 banks, 64 lines/bank
+ *   => 32-bit address partitioned into
+ *         23-bit tag
+ *          6-bit index         [ 6 = log2( 64 lines/bank ) ]
+ *          3-bit byte offset   [ 3 = log2( 8 bytes/line ) ]
+ *
+ * index            bank 0          bank 1
+ * (set) LRU    v d tag cont    v d tag cont
+ *       +-+   +-+-+---+----+  +-+-+---+----+
+ *   0   | |   | | |   |////|  | | |   |////|
+ *       +-+   +-+-+---+----+  +-+-+---+----+
+ *   1   | |   | | |   |////|  | | |   |////|
+ *       +-+   +-+-+---+----+  +-+-+---+----+
+ *       ...        ...             ...
+ *       +-+   +-+-+---+----+  +-+-+---+----+
+ *  63   | |   | | |   |////|  | | |   |////|
+ *       +-+   +-+-+---+----+  +-+-+---+----+
+ *
+ *
+ * LRU replacement using one bit per set, which is exact for 2-way s.a.
+ *
+ *  the bit holds the bank referenced most recently; a miss fills an
+ *  invalid line if the set has one, and otherwise replaces the line
+ *  in the other bank
+ *
+ * note that there is separate state kept for each set (i.e., index value)
+ */
+
+#include "sim88_internal.h"
+
+void cache_init( struct cache *c ){
+  int i;
+  for(i=0; i<LINES_PER_BANK; i++)
+  {
+    c->lru[i] = 0;
+    c->valid[0][i] = c->dirty[0][i] = c->tag[0][i] = 0;
+    c->valid[1][i] = c->dirty[1][i] = c->tag[1][i] = 0;
+  }
+  c->reads = c->writes = c->hits = c->misses = c->write_backs = 0;
+}
+
+void cache_stats( const struct cache *c, FILE *out ){
+  fprintf( out, "cache statistics (in decimal):\n" );
+  fprintf( out, "  cache reads       = %llu\n", c->reads );
+  fprintf( out, "  cache writes      = %llu\n", c->writes );
+  fprintf( out, "  cache hits        = %llu\n", c->hits );
+  fprintf( out, "  cache misses      = %llu\n", c->misses );
+  fprintf( out, "  cache write backs = %llu\n", c->write_backs );
+}
+
+/* address is byte address, type is read (=0) or write (=1) */
+unsigned int cache_access( struct cache *c, unsigned int address, unsigned int type )
+{
+  unsigned int
+    addr_tag,    /* tag bits of address     */
+    addr_index,  /* index bits of address   */
+    bank,        /* bank that hit, or bank chosen for replacement */
+    miss;        /* returned to the caller */
+
+  if(type == 0){
+    c->reads++;
+  }else{
+    c->writes++;
+  }
+
+  addr_index = (address >> 3) & 0x3f;
+  addr_tag = address >> 9;
+
+  miss = 0;
+
+  /* check bank 0 hit */
+  if(c->valid[0][addr_index] && (addr_tag==c->tag[0][addr_index])){
+    c->hits++;
+    bank = 0;
+
+  /* check bank 1 hit */
+  }else if(c->valid[1][addr_index] && (addr_tag==c->tag[1][addr_index])){
+    c->hits++;
+    bank = 1;
+
+  /* miss - choose replacement bank */
+  }else{
+    c->misses++;
+    miss = 1;
+
+    if(!c->valid[0][addr_index]) bank = 0;
+    else if(!c->valid[1][addr_index]) bank = 1;
+    else bank = c->lru[addr_index] ? 0 : 1;
+
+    if(c->valid[bank][addr_index] && c->dirty[bank][addr_index])
+    {
+      c->write_backs++;
+    }
+
+    c->valid[bank][addr_index] = 1;
+    c->dirty[bank][addr_index] = 0;
+    c->tag[bank][addr_index] = addr_tag;
+  }
+
+  /* update replacement state for this set (i.e., index value) */
+  c->lru[addr_index] = bank;
+
+  /* update dirty bit on a write */
+  if(type == 1) c->dirty[bank][addr_index] = 1;
+
+  return miss;
+}
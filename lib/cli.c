@@ -0,0 +1,192 @@
+/* the command line of the simulator programs
+ *
+ * both programs are sim88_main(); the cache simulator only adds the
+ *   data cache to the configuration; with --batch and --serve the
+ *   options on the command line are the defaults of every job
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sim88_internal.h"
+
+static void usage( const char *name ){
+  printf( "usage:\n");
+  printf( "  %s for just execution statistics\n", name );
+  printf( "  %s -t for instruction trace\n", name );
+  printf( "  %s -v for instructions, registers, and memory\n", name );
+  printf( "  %s -p to add a per-instruction execution profile\n", name );
+  printf( "  %s -m to add the dynamic instruction mix\n", name );
+  printf( "  %s --stats-format=json|csv for machine-readable statistics\n",
+    name );
+  printf( "  %s --interval N to write counter deltas every N instructions\n",
+    name );
+  printf( "  %s --interval-file FILE to name the interval file"
+          " (default intervals.csv)\n", name );
+  printf( "  %s --self-profile to time the simulator itself\n", name );
+  printf( "  %s --mem-size MIB to simulate more than 1 MiB of memory\n",
+    name );
+  printf( "  %s --plugin FILE[:ARGS] to load an instrumentation plugin\n",
+    name );
+  printf( "  %s --engine switch|threaded to choose the interpreter\n",
+    name );
+  printf( "  %s --lockstep[=N] to check the threaded engine against"
+          " the switch engine\n", name );
+  printf( "  %s --binary to read big-endian words (asm88 -b)"
+          " instead of hex\n", name );
+  printf( "  %s --limit N to stop after N instructions\n", name );
+  printf( "  %s --batch FILE [--jobs N] to run the jobs of a manifest"
+          " on N threads\n", name );
+  printf( "  %s --serve SOCKET to run jobs sent to a unix socket\n", name );
+  printf( "input is read as hex 32-bit values from stdin\n" );
+  exit( -1 );
+}
+
+/* one option at argv[*i]; 1 if it was used, with *i at its last word, */
+/*   0 if it is not an option, and -1 after a message if its value is  */
+/*   wrong, written to config.out; batch.c and server.c parse the      */
+/*   options of each job with it too                                   */
+
+int parse_option( int argc, char **argv, int *i, struct cli_options *o ){
+  struct sim88_config *c = &o->config;
+  const char *arg = argv[ *i ];
+
+  if( strcmp( arg, "--stats-format=json" ) == 0 ){
+    o->format = SIM88_STATS_JSON;
+  }else if( strcmp( arg, "--stats-format=csv" ) == 0 ){
+    o->format = SIM88_STATS_CSV;
+  }else if( strcmp( arg, "--stats-format=text" ) == 0 ){
+    o->format = SIM88_STATS_TEXT;
+  }else if( ( strcmp( arg, "--engine" ) == 0 ) && ( *i + 1 < argc ) ){
+    arg = argv[ ++*i ];
+    if( strcmp( arg, "switch" ) == 0 ) c->engine = SIM88_ENGINE_SWITCH;
+    else if( strcmp( arg, "threaded" ) == 0 ) c->engine = SIM88_ENGINE_THREADED;
+    else{
+      fprintf( c->out, "unknown engine %s\n", arg );
+      return -1;
+    }
+  }else if( strcmp( arg, "--lockstep" ) == 0 ){
+    c->lockstep_every = 1;
+  }else if( strncmp( arg, "--lockstep=", 11 ) == 0 ){
+    c->lockstep_every = strtoull( arg + 11, NULL, 0 );
+    if( c->lockstep_every == 0 ){
+      fprintf( c->out, "lockstep span must be at least 1 instruction\n" );
+      return -1;
+    }
+  }else if( ( strcmp( arg, "--plugin" ) == 0 ) && ( *i + 1 < argc ) ){
+    o->plugins[ o->num_plugins++ ] = argv[ ++*i ];
+  }else if( ( strcmp( arg, "--mem-size" ) == 0 ) && ( *i + 1 < argc ) ){
+    int mib = atoi( argv[ ++*i ] );
+    if( ( mib < 1 ) || ( mib > SIM88_MAX_MEM_SIZE_IN_MIB ) ){
+      fprintf( c->out, "memory size must be 1 to %d MiB\n", SIM88_MAX_MEM_SIZE_IN_MIB );
+      return -1;
+    }
+    c->mem_size_in_words = mib * 256 * 1024;
+  }else if( ( strcmp( arg, "--limit" ) == 0 ) && ( *i + 1 < argc ) ){
+    c->inst_limit = strtoull( argv[ ++*i ], NULL, 0 );
+  }else if( strcmp( arg, "--binary" ) == 0 ){
+    o->binary_input = 1;
+  }else if( strcmp( arg, "--self-profile" ) == 0 ){
+    c->self_profile = 1;
+  }else if( ( strcmp( arg, "--interval" ) == 0 ) && ( *i + 1 < argc ) ){
+    c->interval_length = strtoull( argv[ ++*i ], NULL, 0 );
+  }else if( ( strcmp( arg, "--interval-file" ) == 0 ) && ( *i + 1 < argc ) ){
+    c->interval_name = argv[ ++*i ];
+  }else if( ( arg[0] == '-' ) && ( arg[1] == 't' ) ){
+    c->trace_level = 1;
+  }else if( ( arg[0] == '-' ) && ( arg[1] == 'v' ) ){
+    c->trace_level = 2;
+  }else if( ( arg[0] == '-' ) && ( arg[1] == 'p' ) ){
+    c->profiling = 1;
+  }else if( ( arg[0] == '-' ) && ( arg[1] == 'm' ) ){
+    c->show_mix = 1;
+  }else{
+    return 0;
+  }
+  return 1;
+}
+
+/* the options of a batch or server job, words[1] to words[argc - 1], */
+/*   which may also choose --cache or --no-cache but not write more    */
+/*   than the statistics; -1 after a message                          */
+
+int parse_job_options( int argc, char **words, struct cli_options *o ){
+  const char *plugin[1];          /* a second --plugin is never parsed */
+
+  o->format = SIM88_STATS_JSON;
+  o->plugins = plugin;
+  o->num_plugins = 0;
+  for( int i = 1; i < argc; i++ ){
+    const char *option = words[ i ];   /* i moves past its value */
+    int used;
+    if( strcmp( words[ i ], "--cache" ) == 0 ){
+      o->config.cache = 1;
+      continue;
+    }else if( strcmp( words[ i ], "--no-cache" ) == 0 ){
+      o->config.cache = 0;
+      continue;
+    }
+    used = parse_option( argc, words, &i, o );
+    if( used < 0 ) return -1;
+    if( ( used == 0 ) || o->config.trace_level || o->config.interval_length
+        || o->num_plugins || ( o->format != SIM88_STATS_JSON ) ){
+      fprintf( o->config.out, "option %s is not allowed in a job\n", option );
+      return -1;
+    }
+  }
+  o->plugins = NULL;
+  return 0;
+}
+
+int sim88_main( int argc, char **argv, int cache ){
+  struct cli_options o = { .format = SIM88_STATS_TEXT };
+  struct sim88 *s;
+  const char *batch = NULL,
+             *serve = NULL;
+  int threads = 0;
+
+  sim88_config_init( &o.config );
+  o.config.cache = cache;
+  o.plugins = calloc( argc, sizeof( char * ) );
+
+  for( int i = 1; i < argc; i++ ){
+    if( ( strcmp( argv[i], "--batch" ) == 0 ) && ( i + 1 < argc ) ){
+      batch = argv[++i];
+    }else if( ( strcmp( argv[i], "--serve" ) == 0 ) && ( i + 1 < argc ) ){
+      serve = argv[++i];
+    }else if( ( strcmp( argv[i], "--jobs" ) == 0 ) && ( i + 1 < argc ) ){
+      threads = atoi( argv[++i] );
+      if( threads < 1 ){
+        printf( "jobs must be at least 1\n" );
+        exit( -1 );
+      }
+    }else{
+      int used = parse_option( argc, argv, &i, &o );
+      if( used < 0 ) exit( -1 );
+      if( used == 0 ) usage( argv[0] );
+    }
+  }
+
+  if( batch || serve ){
+    if( o.num_plugins || o.config.trace_level || o.config.interval_length ){
+      printf( "%s cannot be combined with -t, -v, --interval,"
+              " or --plugin\n", batch ? "--batch" : "--serve" );
+      exit( -1 );
+    }
+    free( o.plugins );
+    if( serve ) return sim88_serve( serve, &o.config, o.binary_input ) ? -1 : 0;
+    return sim88_batch( batch, &o.config, o.binary_input, threads, stdout ) ? -1 : 0;
+  }
+
+  s = sim88_new( &o.config );
+  if( s == NULL ) exit( -1 );
+  for( int i = 0; i < o.num_plugins; i++ ){
+    if( sim88_load_plugin( s, o.plugins[ i ] ) != 0 ) exit( -1 );
+  }
+  free( o.plugins );
+
+  if( sim88_load( s, stdin, o.binary_input ) != 0 ) exit( 0 );
+  if( sim88_run( s ) != 0 ) exit( -1 );
+  sim88_report( s, o.format );
+  sim88_free( s );
+  return 0;
+}
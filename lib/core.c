@@ -0,0 +1,864 @@
+/* behavioral simulation of MC88100 subset for CPSC 3300 at Clemson
+ *
+ * the processor core: decode, the instruction handlers, and the switch
+ *   engine; the threaded engine is in threaded.c
+ *
+ * reference manual is http://www.bitsavers.org/components/motorola/
+ *   88000/MC88100_RISC_Microprocessor_Users_Manual_2ed_1990.pdf
+ *
+ * processor state subset
+ *   32 x 32-bit general registers
+ *     note that r0 is always 0
+ *   two 32-bit instruction address registers
+ *     fip - fetch address pointer
+ *     xip - execute address pointer
+ * 
+ * memory
+ *   byte-addressable
+ *   big-endian addressing
+ *   aligned accesses
+ *   - an instruction starts on an address that is a multiple of 4
+ *   - a data word starts on an address that is a multiple of 4
+ *
+ *   note - the memory is 1 MiB by default; --mem-size MIB selects a
+ *     larger one for the benchmark suite, see memory.c
+ *
+ *   note - instructions are one word (four bytes) in length and
+ *     we also limit the instruction subset in this simulation to
+ *     operations on on word-length data
+ *
+ * we implement all three addressing modes, see pages 3-7 to 3-10
+ *
+ *   register indirect with zero-extended immediate index
+ *     eff_addr = reg[ s1 ] + imm16
+ *
+ *   register indirect with index
+ *     eff_addr = reg[ s1 ] + reg[ s2 ]
+ *
+ *   register indirect with index (word scaling = 2)
+ *     eff_addr = reg[ s1 ] + ( reg[ s2 ] << 2 )
+ *
+ * we implement 53 instructions derived from 31 base instructions, not
+ *   counting the operand sizes of the floating point instructions
+ *
+ *   halt is added for the simulation
+ *   add  is described on pages 3-29 to 3-30
+ *   and, mask, or, and xor are the logical instructions of chapter 3
+ *   mul, div, and divu are the integer multiply and divide of chapter 3
+ *   bb0 and bb1 are the bit branches, and cmp the compare, of chapter 3
+ *   fadd, fsub, fmul, fdiv, flt, and int are the SFU1 floating point
+ *     instructions of chapters 3 and 6
+ *   bcnd is described on pages 3-13 to 3-14 and 3-35 to 3-36
+ *   br   is described on pages 3-16 and 3-37
+ *   bsr, jmp, and jsr are the subroutine branches of chapter 3
+ *   ext  is described on pages 3-44 to 3-45
+ *   extu is described on pages 3-46 to 3-47
+ *   mak  is described on pages 3-70 to 3-71
+ *   rot  is described on page 3-76
+ *   ld   is described on pages 3-65 to 3-66
+ *   lda  is described on pages 3-67 to 3-68
+ *   st   is described on pages 3-79 to 3-80
+ *   sub  is described on pages 3-82 to 3-83
+ *
+ * decoding and instruction formats (op1 is first six bits)
+ *
+ *   op1 = 0 => halt
+ *
+ *   op1 = 0x05, 0x09, 0x0d, 0x1c, 0x1d =>
+ *     opcodes are ld, st, lda, add, sub, respectively
+ *     format has two registers and a 16-bit immediate
+ *     immediate value is zero-extended
+ *     signed words in normal mode used for load/stores,
+ *       so p = 01, ty = 01, and u = 0
+ *     carry and borrow are not used, so i = 0 and o = 0
+ *
+ *   op1 = 0x1a, 0x1b, 0x1e => divu, mul, div
+ *     format has two registers and a 16-bit immediate
+ *     immediate value is zero-extended
+ *     mul keeps the low 32 bits of the product
+ *     a zero divisor is the integer divide trap, a program error here
+ *     div of a negative operand, which the MC88100 traps for software
+ *       to finish, gives the quotient truncated toward zero
+ *
+ *   op1 = 0x10 to 0x17 => and, and.u, mask, mask.u, xor, xor.u, or, or.u
+ *     format has two registers and a 16-bit immediate
+ *     the immediate is the lower half of the second operand, or the
+ *       upper half with .u; and leaves the other half of rS1 as it
+ *       is, mask clears it, and xor and or pass it through
+ *
+ *   op1 = 0x30 => br
+ *     format has a single 26-bit displacement
+ *     displacement is sign-extended
+ *     displacement is in words and calculated from the
+ *       address of the current instruction rather than
+ *
+ *   op1 = 0x31 => bsr
+ *     format and displacement as for br
+ *     r1 is the return address, the address of the next instruction
+ *
+ *   op1 = 0x1f => cmp
+ *     format has two registers and a 16-bit immediate
+ *     immediate value is zero-extended
+ *     rD is the bit string of compare(), bits 2 to 11 for eq, ne, gt,
+ *       le, lt, ge, hi, ls, lo, hs
+ *
+ *   op1 = 0x34, 0x36 => bb0, bb1
+ *     format as for bcnd, with a bit number for the mask
+ *     the branch is taken if that bit of rS1 is 0, or 1, respectively
+ *     displacement, a zero displacement, and n as for bcnd
+ *
+ *   op1 = 0x3a => bcnd
+ *     format has mask, register, and 16-bit displacement
+ *     displacement is sign-extended
+ *     displacement is in words and calculated from the
+ *       address of the current instruction rather than
+ *       the updated fetch address
+ *     a zero displacement is a program error
+ *     delayed branching is not used, so n = 0
+ *
+ *   op1 = 0x3c => ext, extu, mak, rot
+ *     format has two registers and a 5-bit immediate
+ *     ext, extu, and mak are used as shifts so w5 = 0
+ *       the updated fetch address
+ *     a zero displacement is a program error
+ *     delayed branching is not used, so n = 0
+ *
+ *   op1 = 0x3d => ld, st, lda, add, sub
+ *     format has three registers
+ *     for add and sub:
+ *       carry and borrow are not used, so i = 0 and o = 0
+ *     for ld, sta, and lda:
+ *       signed words in normal mode used for load/stores,
+ *         so p = 01, ty = 01, and u = 0
+ *       if bit 9 = 1, the third register is scaled
+ *
+ *   op1 = 0x3d => divu, mul, div
+ *     op2 = 0x1a, 0x1b, 0x1e, respectively
+ *     format has three registers
+ *
+ *   op1 = 0x3d, op2 = 0x1f => cmp, format has three registers
+ *
+ *   op1 = 0x3d => jmp, jsr
+ *     op2 = 0x30, 0x32, respectively
+ *     the target is rS2 with its two low bits cleared
+ *     jsr sets r1 to the return address after reading rS2, so that
+ *       jsr r1 works; jmp r1 is the return
+ *     delayed branching is not used, so n = 0
+ *
+ *   op1 = 0x3d => and, and.c, xor, xor.c, or, or.c
+ *     op2 = 0x10, 0x11, 0x14, 0x15, 0x16, 0x17, respectively
+ *     format has three registers; .c complements rS2
+ *
+ *   op1 = 0x21 => fmul, flt, fadd, fsub, int, fdiv
+ *     bits 15 to 11 = 0x00, 0x04, 0x05, 0x06, 0x09, 0x0e, respectively
+ *     format has three registers and the sizes T1, T2, and TD of rS1,
+ *       rS2, and rD in bits 10-9, 8-7, and 6-5, 0 for single and 1 for
+ *       double, written in that order as the .sss to .ddd suffix
+ *     a double is a register pair, see fp_get() in sim88_internal.h
+ *     flt converts the integer in rS2, and int converts rS2 to an
+ *       integer rounded to nearest; an int that does not fit is the
+ *       integer conversion overflow trap, a program error here
+ *     results are the IEEE default results of the host, since the
+ *       FPCR has all exceptions disabled at reset; the FPSR, the
+ *       control registers, and fcmp, nint, and trnc are not simulated
+ */
+
+#include <stdlib.h>
+#include "sim88_internal.h"
+
+const char *op_names[NUM_OPS] = {
+  "halt",
+  "ld   (imm)", "st   (imm)", "lda  (imm)", "add  (imm)", "sub  (imm)",
+  "br", "bcnd",
+  "ext", "extu", "mak", "rot",
+  "ld   (reg)", "ld   (scaled)", "st   (reg)", "st   (scaled)",
+  "lda  (reg)", "lda  (scaled)",
+  "add  (reg)", "sub  (reg)",
+  "and  (imm)", "and.u", "mask", "mask.u",
+  "xor  (imm)", "xor.u", "or   (imm)", "or.u",
+  "and  (reg)", "and.c", "xor  (reg)", "xor.c", "or   (reg)", "or.c",
+  "mul  (imm)", "div  (imm)", "divu (imm)", "mul  (reg)", "div  (reg)",
+  "divu (reg)",
+  "bsr", "jmp", "jsr",
+  "cmp  (imm)", "cmp  (reg)", "bb0", "bb1",
+  "fadd", "fsub", "fmul", "fdiv", "flt", "int"
+};
+
+/* names used for the instruction mix in machine-readable output */
+
+const char *op_keys[NUM_OPS] = {
+  "halt",
+  "imm_ld", "imm_st", "imm_lda", "imm_add", "imm_sub",
+  "br", "bcnd",
+  "ext", "extu", "mak", "rot",
+  "ld", "ld_scaled", "st", "st_scaled", "lda", "lda_scaled",
+  "add", "sub",
+  "imm_and", "and_u", "mask", "mask_u", "imm_xor", "xor_u", "imm_or", "or_u",
+  "and", "and_c", "xor", "xor_c", "or", "or_c",
+  "imm_mul", "imm_div", "imm_divu", "mul", "div", "divu",
+  "bsr", "jmp", "jsr",
+  "imm_cmp", "cmp", "bb0", "bb1",
+  "fadd", "fsub", "fmul", "fdiv", "flt", "int"
+};
+
+/* extract fields - switch statements are in main loop */
+
+void decode( struct sim88 *s ){
+  int ir = s->ir;
+  s->op1    = ( ir >> 26 ) & 0x3f;
+  s->op2    = ( ir >> 10 ) & 0x3f;
+  s->d      = ( ir >> 21 ) & 0x1f;
+  s->s1     = ( ir >> 16 ) & 0x1f;
+  s->s2     =   ir         & 0x1f;
+  s->imm16  =   ir         & 0xffff;
+  s->scaled = ( ir >>  9 ) & 1;
+}
+
+/* the names of the bits of cmp, for bb0 and bb1 */
+
+static const char *cmp_names[32] = {
+  NULL, NULL, "eq", "ne", "gt", "le", "lt", "ge", "hi", "ls", "lo", "hs"
+};
+
+/* the suffix letters of the floating point operand sizes */
+
+static const char fp_sizes[2] = { 's', 'd' };
+
+/* format the decoded instruction the way the trace shows it; the */
+/*   profile report uses the same text                            */
+
+void disasm( struct sim88 *s, char *buf ){
+  int ir = s->ir, d = s->d, s1 = s->s1, s2 = s->s2, imm16 = s->imm16,
+      d16 = imm16,
+      d26 = ir & 0x03ffffff;
+
+  switch( s->op1 ){
+    case 0x00: sprintf( buf, "halt" );                                 break;
+    case 0x05: sprintf( buf, "ld   r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x09: sprintf( buf, "st   r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x0d: sprintf( buf, "lda  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x1c: sprintf( buf, "add  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x1d: sprintf( buf, "sub  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x1a: sprintf( buf, "divu r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x1b: sprintf( buf, "mul  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x1e: sprintf( buf, "div  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x1f: sprintf( buf, "cmp  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x10: sprintf( buf, "and  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x11: sprintf( buf, "and.u r%x,r%x,%x", d, s1, imm16 );       break;
+    case 0x12: sprintf( buf, "mask r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x13: sprintf( buf, "mask.u r%x,r%x,%x", d, s1, imm16 );      break;
+    case 0x14: sprintf( buf, "xor  r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x15: sprintf( buf, "xor.u r%x,r%x,%x", d, s1, imm16 );       break;
+    case 0x16: sprintf( buf, "or   r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x17: sprintf( buf, "or.u r%x,r%x,%x", d, s1, imm16 );        break;
+    case 0x30:
+      buf += sprintf( buf, "br   %x", d26 );
+      d26 = ( d26 << 6 ) >> 6;
+      if( ( d26 < 0 ) || ( d26 > 9 ) ) sprintf( buf, " (= decimal %d)", d26 );
+      break;
+    case 0x31:
+      d26 = ir & 0x03ffffff;
+      buf += sprintf( buf, "bsr  %x", d26 );
+      d26 = ( d26 << 6 ) >> 6;
+      if( ( d26 < 0 ) || ( d26 > 9 ) ) sprintf( buf, " (= decimal %d)", d26 );
+      break;
+    case 0x34:
+    case 0x36:
+      buf += sprintf( buf, "bb%d  ", ( s->op1 == 0x36 ) );
+      if( cmp_names[ d ] ) buf += sprintf( buf, "%s,r%x,%x", cmp_names[ d ], s1, d16 );
+      else                 buf += sprintf( buf, "%x,r%x,%x", d, s1, d16 );
+      d16 = ( d16 << 16 ) >> 16;
+      if( d16 < 0 ) sprintf( buf, " (= decimal %d)", d16 );
+      break;
+    case 0x3a:
+      switch( d ){
+        case 0x2: buf += sprintf( buf, "bcnd eq0,r%d,%x", s1, d16 );    break;
+        case 0xd: buf += sprintf( buf, "bcnd ne0,r%d,%x", s1, d16 );    break;
+        case 0x1: buf += sprintf( buf, "bcnd gt0,r%d,%x", s1, d16 );    break;
+        case 0xc: buf += sprintf( buf, "bcnd lt0,r%d,%x", s1, d16 );    break;
+        case 0x3: buf += sprintf( buf, "bcnd ge0,r%d,%x", s1, d16 );    break;
+        case 0xe: buf += sprintf( buf, "bcnd le0,r%d,%x", s1, d16 );    break;
+        case 0xf: buf += sprintf( buf, "bcnd always,r%d,%x", s1, d16 ); break;
+        case 0:   buf += sprintf( buf, "bcnd never,r%d,%x", s1, d16 );  break;
+        default:  buf += sprintf( buf, "bcnd mask=%x,r%d,%x", d, s1, d16 );
+      }
+      d16 = ( d16 << 16 ) >> 16;
+      if( d16 < 0 ) sprintf( buf, " (= decimal %d)", d16 );
+      break;
+    case 0x3c:
+      switch( s->op2 ){
+        case 0x24: sprintf( buf, "ext  r%x,r%x,%x", d, s1, s2 );        break;
+        case 0x26: sprintf( buf, "extu r%x,r%x,%x", d, s1, s2 );        break;
+        case 0x28: sprintf( buf, "mak  r%x,r%x,%x", d, s1, s2 );        break;
+        case 0x2a: sprintf( buf, "rot  r%x,r%x,%x", d, s1, s2 );        break;
+        default:   sprintf( buf, "unknown %08x", ir );
+      }
+      break;
+    case 0x3d:
+      switch( s->op2 ){
+        case 0x05:
+          if( s->scaled ) sprintf( buf, "ld   r%x,r%x[r%x]", d, s1, s2 );
+          else            sprintf( buf, "ld   r%x,r%x,r%x", d, s1, s2 );
+          break;
+        case 0x09:
+          if( s->scaled ) sprintf( buf, "st   r%x,r%x[r%x]", d, s1, s2 );
+          else            sprintf( buf, "st   r%x,r%x,r%x", d, s1, s2 );
+          break;
+        case 0x0d:
+          if( s->scaled ) sprintf( buf, "lda  r%x,r%x[r%x]", d, s1, s2 );
+          else            sprintf( buf, "lda  r%x,r%x,r%x", d, s1, s2 );
+          break;
+        case 0x1c: sprintf( buf, "add  r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x1d: sprintf( buf, "sub  r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x1a: sprintf( buf, "divu r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x30: sprintf( buf, "jmp  r%x", s2 );                      break;
+        case 0x32: sprintf( buf, "jsr  r%x", s2 );                      break;
+        case 0x1b: sprintf( buf, "mul  r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x1e: sprintf( buf, "div  r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x1f: sprintf( buf, "cmp  r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x10: sprintf( buf, "and  r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x11: sprintf( buf, "and.c r%x,r%x,r%x", d, s1, s2 );      break;
+        case 0x14: sprintf( buf, "xor  r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x15: sprintf( buf, "xor.c r%x,r%x,r%x", d, s1, s2 );      break;
+        case 0x16: sprintf( buf, "or   r%x,r%x,r%x", d, s1, s2 );       break;
+        case 0x17: sprintf( buf, "or.c r%x,r%x,r%x", d, s1, s2 );       break;
+        default:   sprintf( buf, "unknown %08x", ir );
+      }
+      break;
+    case 0x21:{
+      static const char *names[32] = {
+        [ 0x00 ] = "fmul", [ 0x05 ] = "fadd", [ 0x06 ] = "fsub", [ 0x0e ] = "fdiv"
+      };
+      int op = ( ir >> 11 ) & 0x1f,
+          t1 = fp_sizes[ ( ir >> 9 ) & 1 ],
+          t2 = fp_sizes[ ( ir >> 7 ) & 1 ],
+          td = fp_sizes[ ( ir >> 5 ) & 1 ];
+
+      if( !fp_valid( ir ) )  sprintf( buf, "unknown %08x", ir );
+      else if( op == 0x04 )  sprintf( buf, "flt.%cs r%x,r%x", td, d, s2 );
+      else if( op == 0x09 )  sprintf( buf, "int.s%c r%x,r%x", t2, d, s2 );
+      else sprintf( buf, "%s.%c%c%c r%x,r%x,r%x", names[ op ], td, t1, t2, d, s1, s2 );
+      break;
+    }
+    default:   sprintf( buf, "unknown %08x", ir );
+  }
+}
+
+static void trace_inst( struct sim88 *s ){
+  char buf[64];
+  if( s->self_profile ) tsc_mark( s, HOST_EXECUTE );
+  disasm( s, buf );
+  fprintf( s->out, "%s\n", buf );
+  if( s->self_profile ) tsc_mark( s, HOST_TRACE );
+}
+
+void unknown_op( struct sim88 *s ){
+  sim88_fail( s, "unknown instruction %08x\n"
+                 " op1=%x op2=%x d=%x s1=%x s2=%x\n"
+                 "program terminates\n",
+    s->ir, s->op1, s->op2, s->d, s->s1, s->s2 );
+}
+
+void divide_by_zero( struct sim88 *s ){
+  sim88_fail( s, "integer divide by zero at %x\n"
+                 "program terminates\n", s->xip );
+}
+
+void conversion_overflow( struct sim88 *s ){
+  sim88_fail( s, "integer conversion overflow at %x\n"
+                 "program terminates\n", s->xip );
+}
+
+static void zero_displacement( struct sim88 *s ){
+  sim88_fail( s, "branch at %x has a zero displacement\n"
+                 "program terminates\n", s->xip );
+}
+
+/* the handlers; reg[] is s->reg[] */
+
+#define reg s->reg
+
+static void halt( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  s->halt_flag = 1;
+}
+
+static void imm_ld( struct sim88 *s ){  /* pages 3-65 to 3-66 */
+  if( s->verbose ) trace_inst( s );
+  int address = reg[s->s1] + s->imm16;
+  read_mem( s, address, s->d );
+}
+
+static void imm_st( struct sim88 *s ){  /* pages 3-79 to 3-80 */
+  if( s->verbose ) trace_inst( s );
+  int address = reg[s->s1] + s->imm16;
+  write_mem( s, address, s->d );
+}
+
+static void imm_lda( struct sim88 *s ){  /* pages 3-67 to 3-68 */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] + s->imm16;
+}
+
+static void imm_add( struct sim88 *s ){  /* carry not used; pages 3-29 to 3-30 */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] + s->imm16;
+}
+
+static void imm_sub( struct sim88 *s ){  /* borrow not used; pages 3-82 to 3-83 */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] - s->imm16;
+}
+
+static void imm_mul( struct sim88 *s ){  /* low 32 bits of the product */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = (unsigned int)reg[s->s1] * s->imm16;
+}
+
+static void imm_div( struct sim88 *s ){
+  if( s->imm16 == 0 ) divide_by_zero( s );
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] / s->imm16;
+}
+
+static void imm_divu( struct sim88 *s ){
+  if( s->imm16 == 0 ) divide_by_zero( s );
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = (unsigned int)reg[s->s1] / s->imm16;
+}
+
+/* the 16-bit immediate is zero-extended, and shifted to the upper */
+/*   half by the .u forms                                          */
+
+static void imm_and( struct sim88 *s ){  /* upper half of rS1 unchanged */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] & ( 0xffff0000u | s->imm16 );
+}
+
+static void imm_and_u( struct sim88 *s ){  /* lower half of rS1 unchanged */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] & ( ( (unsigned int)s->imm16 << 16 ) | 0xffff );
+}
+
+static void imm_mask( struct sim88 *s ){  /* upper half cleared */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] & s->imm16;
+}
+
+static void imm_mask_u( struct sim88 *s ){  /* lower half cleared */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] & ( (unsigned int)s->imm16 << 16 );
+}
+
+static void imm_xor( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] ^ s->imm16;
+}
+
+static void imm_xor_u( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] ^ ( (unsigned int)s->imm16 << 16 );
+}
+
+static void imm_or( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] | s->imm16;
+}
+
+static void imm_or_u( struct sim88 *s ){  /* with or, a 32-bit constant */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] | ( (unsigned int)s->imm16 << 16 );
+}
+
+static void br( struct sim88 *s ){  /* n = 0; * pages 3-16 and 3-37 */
+    int d26 = s->ir & 0x03ffffff;
+    if (d26 == 0) zero_displacement(s);
+    if (s->verbose) trace_inst(s);
+    d26 = d26 << 6;
+    d26 = d26 >> 6;
+    s->fip = s->xip + (d26 << 2);
+    s->branches++;
+    s->taken_branches++;
+    s->profile[s->xip >> 2].taken++;
+}
+
+static void bsr( struct sim88 *s ){  /* n = 0 */
+    int d26 = s->ir & 0x03ffffff;
+    if (d26 == 0) zero_displacement(s);
+    if (s->verbose) trace_inst(s);
+    d26 = d26 << 6;
+    d26 = d26 >> 6;
+    reg[1] = s->xip + 4;
+    s->fip = s->xip + (d26 << 2);
+    s->branches++;
+    s->taken_branches++;
+    s->profile[s->xip >> 2].taken++;
+}
+
+static void bcnd( struct sim88 *s ){  /* n = 0; pages 3-13 to 3-14 and 3-35 to 3-36 */
+    int d16 = s->ir & 0x0000ffff;
+    if (d16 == 0) zero_displacement(s);
+
+    int sign = ((unsigned int) reg[s->s1]) >> 31;
+    int zero = (((unsigned int) reg[s->s1] << 1) == 0);
+    int flag = (sign << 1) | zero;
+
+    if(s->verbose) trace_inst(s);
+
+    s->branches++;
+
+    d16 = d16 << 16;
+    d16 = d16 >> 16;
+
+    if ((1 & ((unsigned int)s->d >> flag)) == 1) {
+        s->fip = s->xip + (d16 << 2);
+        s->taken_branches++;
+        s->profile[s->xip >> 2].taken++;
+    }
+}
+
+static void ext( struct sim88 *s ){  /* immediate form, w5 = 0: pages 3-25 and 3-46 */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] >> s->s2;
+}
+
+static void extu( struct sim88 *s ){  /* immediate form, w5 = 0: pages 3-25 and 3-47 */
+  if( s->verbose ) trace_inst( s );
+  unsigned int u = (unsigned int)reg[s->s1];
+  u = u >> s->s2;
+  reg[s->d] = u;
+}
+
+static void mak( struct sim88 *s ){  /* immediate form, w5 = 0: pages 3-26 and 3-70 to 3-71 */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] << s->s2;
+}
+
+/* for rotate
+ *
+ *   (32-n) bits   n bits
+ * +-------------+-------+
+ * |      A      |   B   |
+ * +-------------+-------+
+ *
+ * value 1 = AB shift left (32-n) bits
+ * +-------+-------------+
+ * |   B   |      0      |
+ * +-------+-------------+
+ *
+ * value 2 = AB logical shift right n bits
+ * +-------+-------------+
+ * |   0   |      A      |
+ * +-------+-------------+
+ *
+ * now or the two values together
+ * +-------+-------------+
+ * |   B   |      A      |
+ * +-------+-------------+
+ */
+static void rot( struct sim88 *s ){  /* to the right, immediate form; pages 3-26 and 3-76 */
+  if( s->verbose ) trace_inst( s );
+  unsigned int u = (unsigned int)reg[s->s1];  /* logical shift for value 2 */
+  reg[s->d] = (u << ((32 - s->s2) & 31)) | (u >> s->s2);
+}
+
+static void ld( struct sim88 *s ){  /* pages 3-65 to 3-66 */
+  if( s->verbose ) trace_inst( s );
+  if( s->scaled ){
+    int address = (reg[s->s1] + (reg[s->s2] << 2));
+    read_mem( s, address, s->d );
+  }else{
+    int address = reg[s->s1] + reg[s->s2];
+    read_mem( s, address, s->d );
+  }
+}
+
+static void st( struct sim88 *s ){  /* pages 3-79 to 3-80 */
+  if( s->verbose ) trace_inst( s );
+  if( s->scaled ){
+    int address = (reg[s->s1] + (reg[s->s2] << 2));
+    write_mem( s, address, s->d );
+  }else{
+    int address = reg[s->s1] + reg[s->s2];
+    write_mem( s, address, s->d );
+  }
+}
+
+static void lda( struct sim88 *s ){  /* pages 3-67 to 3-68 */
+  if( s->verbose ) trace_inst( s );
+  if( s->scaled ){
+    reg[s->d] = (reg[s->s1] + (reg[s->s2] << 2));
+  }else{
+    reg[s->d] = reg[s->s1] + reg[s->s2];
+  }
+}
+
+static void add( struct sim88 *s ){  /* carry not used; pages 3-29 to 3-30 */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] + reg[s->s2];
+}
+
+static void sub( struct sim88 *s ){  /* borrow not used; pages 3-82 to 3-83 */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] - reg[s->s2];
+}
+
+static void mul( struct sim88 *s ){  /* low 32 bits of the product */
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = (unsigned int)reg[s->s1] * (unsigned int)reg[s->s2];
+}
+
+static void divs( struct sim88 *s ){  /* div, a name taken by stdlib.h */
+  if( reg[s->s2] == 0 ) divide_by_zero( s );
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = quotient( reg[s->s1], reg[s->s2] );
+}
+
+static void divu( struct sim88 *s ){
+  if( reg[s->s2] == 0 ) divide_by_zero( s );
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = (unsigned int)reg[s->s1] / (unsigned int)reg[s->s2];
+}
+
+static void imm_cmp( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = compare( reg[s->s1], s->imm16 );
+}
+
+static void cmp( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = compare( reg[s->s1], reg[s->s2] );
+}
+
+/* bb0 and bb1 test bit d of rS1; n = 0 */
+
+static void bb( struct sim88 *s, int value ){
+  int d16 = s->ir & 0x0000ffff;
+  if( d16 == 0 ) zero_displacement( s );
+  if( s->verbose ) trace_inst( s );
+  s->branches++;
+  d16 = d16 << 16;
+  d16 = d16 >> 16;
+  if( ( ( (unsigned int)reg[s->s1] >> s->d ) & 1 ) == value ){
+    s->fip = s->xip + ( d16 << 2 );
+    s->taken_branches++;
+    s->profile[s->xip >> 2].taken++;
+  }
+}
+
+static void jmp( struct sim88 *s ){  /* n = 0 */
+  if( s->verbose ) trace_inst( s );
+  s->fip = reg[s->s2] & ~3;
+  s->branches++;
+  s->taken_branches++;
+  s->profile[s->xip >> 2].taken++;
+}
+
+static void jsr( struct sim88 *s ){  /* n = 0; rS2 is read before r1 is set */
+  if( s->verbose ) trace_inst( s );
+  s->fip = reg[s->s2] & ~3;
+  reg[1] = s->xip + 4;
+  s->branches++;
+  s->taken_branches++;
+  s->profile[s->xip >> 2].taken++;
+}
+
+/* the .c forms complement rS2 */
+
+static void and( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] & reg[s->s2];
+}
+
+static void and_c( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] & ~reg[s->s2];
+}
+
+static void xor( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] ^ reg[s->s2];
+}
+
+static void xor_c( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] ^ ~reg[s->s2];
+}
+
+static void or( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] | reg[s->s2];
+}
+
+static void or_c( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = reg[s->s1] | ~reg[s->s2];
+}
+
+/* floating point; T1, T2, and TD are the operand sizes, see fp_get() */
+
+#define T1 ( ( s->ir >> 9 ) & 3 )
+#define T2 ( ( s->ir >> 7 ) & 3 )
+#define TD ( ( s->ir >> 5 ) & 3 )
+
+static void fadd( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  fp_set( reg, s->d, TD, fp_get( reg, s->s1, T1 ) + fp_get( reg, s->s2, T2 ) );
+}
+
+static void fsub( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  fp_set( reg, s->d, TD, fp_get( reg, s->s1, T1 ) - fp_get( reg, s->s2, T2 ) );
+}
+
+static void fmul( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  fp_set( reg, s->d, TD, fp_get( reg, s->s1, T1 ) * fp_get( reg, s->s2, T2 ) );
+}
+
+static void fdiv( struct sim88 *s ){  /* a zero divisor gives an infinity */
+  if( s->verbose ) trace_inst( s );
+  fp_set( reg, s->d, TD, fp_get( reg, s->s1, T1 ) / fp_get( reg, s->s2, T2 ) );
+}
+
+static void flt( struct sim88 *s ){
+  if( s->verbose ) trace_inst( s );
+  fp_set( reg, s->d, TD, reg[s->s2] );
+}
+
+static void fint( struct sim88 *s ){  /* int, a keyword */
+  int result;
+  if( !fp_int( fp_get( reg, s->s2, T2 ), &result ) ) conversion_overflow( s );
+  if( s->verbose ) trace_inst( s );
+  reg[s->d] = result;
+}
+
+#undef T1
+#undef T2
+#undef TD
+#undef reg
+
+
+/* the main loop of the switch engine is instantiated twice:          */
+/*   run_plain() has every plugin hook compiled out and is used unless */
+/*   a plugin has been loaded; the hooked loop also stops when          */
+/*   inst_fetches reaches run_limit, so that --lockstep can run it a    */
+/*   span at a time                                                     */
+
+static inline __attribute__(( always_inline )) void run( struct sim88 *s,
+                                                         const int hooked ){
+  unsigned long long reads, writes, taken;
+
+  while( !s->halt_flag && ( !hooked || ( s->inst_fetches < s->run_limit ) ) ){
+
+    if( s->verbose ) fprintf( s->out, "at %02x, ", s->fip );
+    if( s->verbose && s->self_profile ) tsc_mark( s, HOST_TRACE );
+    s->xip = s->fip;
+    if( (unsigned int)s->xip >> 2 >= (unsigned int)s->mem_size_in_words ){
+      bad_address( s, s->xip );
+    }
+    s->ir = s->mem[ s->xip >> 2 ];  /* adjust for word addressing of mem[] */
+    s->fip = s->xip + 4;
+    s->inst_fetches++;
+    s->profile[ s->xip >> 2 ].execs++;
+    if( s->track_working_set ) ws_touch( s, &s->ws_inst, s->xip );
+
+    if( hooked ) plugin_fetch( s );
+
+    decode( s );
+    if( hooked ) plugin_decode( s );
+    if( s->self_profile ) tsc_mark( s, HOST_FETCH );
+
+    reads = s->memory_reads;
+    writes = s->memory_writes;
+    taken = s->taken_branches;
+
+    switch( s->op1 ){
+      case 0x00:        s->op_counts[ OP_HALT ]++;            halt( s );     break;
+      case 0x05:        s->op_counts[ OP_IMM_LD ]++;          imm_ld( s );   break;
+      case 0x09:        s->op_counts[ OP_IMM_ST ]++;          imm_st( s );   break;
+      case 0x0d:        s->op_counts[ OP_IMM_LDA ]++;         imm_lda( s );  break;
+      case 0x1c:        s->op_counts[ OP_IMM_ADD ]++;         imm_add( s );  break;
+      case 0x1d:        s->op_counts[ OP_IMM_SUB ]++;         imm_sub( s );  break;
+      case 0x1a:        s->op_counts[ OP_IMM_DIVU ]++;        imm_divu( s ); break;
+      case 0x1b:        s->op_counts[ OP_IMM_MUL ]++;         imm_mul( s );  break;
+      case 0x1e:        s->op_counts[ OP_IMM_DIV ]++;         imm_div( s );  break;
+      case 0x10:        s->op_counts[ OP_IMM_AND ]++;         imm_and( s );  break;
+      case 0x11:        s->op_counts[ OP_IMM_AND_U ]++;       imm_and_u( s ); break;
+      case 0x12:        s->op_counts[ OP_IMM_MASK ]++;        imm_mask( s ); break;
+      case 0x13:        s->op_counts[ OP_IMM_MASK_U ]++;      imm_mask_u( s ); break;
+      case 0x14:        s->op_counts[ OP_IMM_XOR ]++;         imm_xor( s );  break;
+      case 0x15:        s->op_counts[ OP_IMM_XOR_U ]++;       imm_xor_u( s ); break;
+      case 0x16:        s->op_counts[ OP_IMM_OR ]++;          imm_or( s );   break;
+      case 0x17:        s->op_counts[ OP_IMM_OR_U ]++;        imm_or_u( s ); break;
+      case 0x30:        s->op_counts[ OP_BR ]++;              br( s );       break;
+      case 0x31:        s->op_counts[ OP_BSR ]++;             bsr( s );      break;
+      case 0x3a:        s->op_counts[ OP_BCND ]++;            bcnd( s );     break;
+      case 0x34:        s->op_counts[ OP_BB0 ]++;             bb( s, 0 );    break;
+      case 0x36:        s->op_counts[ OP_BB1 ]++;             bb( s, 1 );    break;
+      case 0x1f:        s->op_counts[ OP_IMM_CMP ]++;         imm_cmp( s );  break;
+      case 0x3c:
+        switch( s->op2 ){
+          case 0x24:    s->op_counts[ OP_EXT ]++;             ext( s );      break;
+          case 0x26:    s->op_counts[ OP_EXTU ]++;            extu( s );     break;
+          case 0x28:    s->op_counts[ OP_MAK ]++;             mak( s );      break;
+          case 0x2a:    s->op_counts[ OP_ROT ]++;             rot( s );      break;
+          default:      unknown_op( s );
+        }
+        break;
+      case 0x3d:
+        switch( s->op2 ){
+          case 0x05:    s->op_counts[ OP_LD + s->scaled ]++;  ld( s );       break;
+          case 0x09:    s->op_counts[ OP_ST + s->scaled ]++;  st( s );       break;
+          case 0x0d:    s->op_counts[ OP_LDA + s->scaled ]++; lda( s );      break;
+          case 0x1c:    s->op_counts[ OP_ADD ]++;             add( s );      break;
+          case 0x1d:    s->op_counts[ OP_SUB ]++;             sub( s );      break;
+          case 0x1a:    s->op_counts[ OP_DIVU ]++;            divu( s );     break;
+          case 0x1f:    s->op_counts[ OP_CMP ]++;             cmp( s );      break;
+          case 0x30:    s->op_counts[ OP_JMP ]++;             jmp( s );      break;
+          case 0x32:    s->op_counts[ OP_JSR ]++;             jsr( s );      break;
+          case 0x1b:    s->op_counts[ OP_MUL ]++;             mul( s );      break;
+          case 0x1e:    s->op_counts[ OP_DIV ]++;             divs( s );     break;
+          case 0x10:    s->op_counts[ OP_AND ]++;             and( s );      break;
+          case 0x11:    s->op_counts[ OP_AND_C ]++;           and_c( s );    break;
+          case 0x14:    s->op_counts[ OP_XOR ]++;             xor( s );      break;
+          case 0x15:    s->op_counts[ OP_XOR_C ]++;           xor_c( s );    break;
+          case 0x16:    s->op_counts[ OP_OR ]++;              or( s );       break;
+          case 0x17:    s->op_counts[ OP_OR_C ]++;            or_c( s );     break;
+          default:      unknown_op( s );
+        }
+        break;
+      case 0x21:
+        if( !fp_valid( s->ir ) ) unknown_op( s );
+        switch( ( s->ir >> 11 ) & 0x1f ){
+          case 0x05:    s->op_counts[ OP_FADD ]++;            fadd( s );     break;
+          case 0x06:    s->op_counts[ OP_FSUB ]++;            fsub( s );     break;
+          case 0x00:    s->op_counts[ OP_FMUL ]++;            fmul( s );     break;
+          case 0x0e:    s->op_counts[ OP_FDIV ]++;            fdiv( s );     break;
+          case 0x04:    s->op_counts[ OP_FLT ]++;             flt( s );      break;
+          case 0x09:    s->op_counts[ OP_INT ]++;             fint( s );     break;
+        }
+        break;
+      default:          unknown_op( s );
+    }
+
+    s->reg[ 0 ] = 0;  /* make sure that r0 stays 0 */
+    if( hooked ) plugin_retire( s, reads, writes, taken );
+    if( s->self_profile ) tsc_mark( s, HOST_EXECUTE );
+
+    if( s->inst_fetches == s->next_interval ) interval_snapshot( s );
+
+    if( ( s->verbose > 1 ) || ( s->halt_flag && ( s->verbose == 1 )) ){
+      for( int i = 0; i < 8 ; i++ ){
+        fprintf( s->out, "  r%x: %08x", i , s->reg[ i ] );
+        fprintf( s->out, "  r%x: %08x", i + 8 , s->reg[ i + 8 ] );
+        fprintf( s->out, "  r%x: %08x", i + 16, s->reg[ i + 16 ] );
+        fprintf( s->out, "  r%x: %08x\n", i + 24, s->reg[ i + 24 ] );
+      }
+    }
+  }
+}
+
+void run_plain( struct sim88 *s ){ run( s, 0 ); }
+
+void run_hooked( struct sim88 *s ){ run( s, 1 ); }
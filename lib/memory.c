@@ -0,0 +1,166 @@
+/* memory backend
+ *
+ * memory is byte-addressable, big-endian, and accessed only as aligned
+ *   words, so it is kept as an array of mem_size_in_words words; the
+ *   size is 1 MiB by default and up to SIM88_MAX_MEM_SIZE_IN_MIB
+ *
+ * read_mem() and write_mem() are the data accesses of the switch
+ *   engine; they count the access, charge it to the instruction in the
+ *   profile, and pass it to the working set and the data cache; they
+ *   leave the effective address in eff_addr so that memory events can
+ *   be reported to plugins after execution
+ */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "sim88_internal.h"
+
+/* the memory, the profile, and the predecoded code are large and     */
+/*   mostly untouched, so they are mapped rather than allocated: pages */
+/*   are zeroed when first touched, where calloc() clears the whole    */
+/*   block once the allocator reuses freed memory for it, which costs  */
+/*   more than a small program takes to run                           */
+
+void *map_zeroed( size_t size ){
+  void *p = mmap( NULL, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  return ( p == MAP_FAILED ) ? NULL : p;
+}
+
+void unmap( void *p, size_t size ){
+  if( p ) munmap( p, size );
+}
+
+int mem_alloc( struct sim88 *s ){
+  s->mem = map_zeroed( s->mem_size_in_words * sizeof( int ) );
+  s->profile = map_zeroed( s->mem_size_in_words * sizeof( struct pc_profile ) );
+  if( ( s->mem == NULL ) || ( s->profile == NULL ) ){
+    fprintf( s->out, "cannot allocate %d words of memory\n", s->mem_size_in_words );
+    return -1;
+  }
+  return 0;
+}
+
+void mem_free( struct sim88 *s ){
+  unmap( s->mem, s->mem_size_in_words * sizeof( int ) );
+  unmap( s->profile, s->mem_size_in_words * sizeof( struct pc_profile ) );
+  s->mem = NULL;
+  s->profile = NULL;
+}
+
+void bad_address( struct sim88 *s, unsigned int address ){
+  sim88_fail( s, "address %x at %x is outside the memory\n"
+                 "program terminates\n", address, s->xip );
+}
+
+/* load memory from a file, as hex words or, with binary set, as the */
+/*   big-endian words that asm88 -b writes; the program may fill     */
+/*   the whole memory                                                */
+
+static int read_word( FILE *in, int binary, int *w ){
+  unsigned char b[4];
+
+  if( !binary ) return fscanf( in, "%x", w ) == 1;
+  if( fread( b, 4, 1, in ) != 1 ) return 0;
+  *w = (int)( ( (unsigned int)b[0] << 24 ) | ( (unsigned int)b[1] << 16 )
+            | ( (unsigned int)b[2] << 8 ) | b[3] );
+  return 1;
+}
+
+int sim88_load( struct sim88 *s, FILE *in, int binary ){
+  int w, count = 0;
+
+  if( s->verbose > 1 ) fprintf( s->out, "reading words in %s from stdin:\n",
+                         binary ? "binary" : "hex" );
+  while( read_word( in, binary, &w ) ){
+    if( s->verbose > 1 ) fprintf( s->out, "  0%08x\n", w );
+    if( count >= s->mem_size_in_words ){
+      fprintf( s->out, "too many words loaded\n" );
+      return -1;
+    }
+    s->mem[ count ] = w;
+    count++;
+  }
+  if( s->verbose > 1 ) fprintf( s->out, "\n" );
+  return 0;
+}
+
+/* read a whole program into a new array, for loading it more than */
+/*   once; -1 if it cannot be allocated                              */
+
+int read_program( FILE *in, int binary, unsigned int **words,
+                  unsigned int *count ){
+  unsigned int max = 1024;
+  int w;
+
+  *count = 0;
+  *words = malloc( max * sizeof( unsigned int ) );
+  while( *words && read_word( in, binary, &w ) ){
+    if( *count == max ){
+      unsigned int *more = realloc( *words, 2 * max * sizeof( unsigned int ) );
+      if( more == NULL ) free( *words );
+      *words = more;
+      max *= 2;
+      if( more == NULL ) break;
+    }
+    (*words)[ (*count)++ ] = (unsigned int)w;
+  }
+  return *words ? 0 : -1;
+}
+
+int sim88_load_words( struct sim88 *s, const unsigned int *words,
+                      unsigned int count ){
+  if( count > (unsigned int)s->mem_size_in_words ){
+    fprintf( s->out, "too many words loaded\n" );
+    return -1;
+  }
+  for( unsigned int i = 0; i < count; i++ ) s->mem[ i ] = (int)words[ i ];
+  return 0;
+}
+
+unsigned int sim88_read_word( const struct sim88 *s, unsigned int address ){
+  unsigned int word_addr = address >> 2;
+  return ( word_addr < (unsigned int)s->mem_size_in_words ) ? s->mem[ word_addr ] : 0;
+}
+
+/* data cache references go through cache_ref() so that misses are */
+/*   charged to the instruction and the cache model is timed        */
+/*   separately by --self-profile                                   */
+
+static void cache_ref( struct sim88 *s, unsigned int address, unsigned int type ){
+  if( s->self_profile ) tsc_mark( s, HOST_EXECUTE );
+  s->profile[ s->xip >> 2 ].misses += cache_access( s->cache, address, type );
+  if( s->self_profile ) tsc_mark( s, HOST_CACHE );
+}
+
+void read_mem( struct sim88 *s, int address, int reg_index ){
+  unsigned int word_addr = (unsigned int)address >> 2;
+  s->eff_addr = address;
+  if( s->verbose ){
+    if( s->self_profile ) tsc_mark( s, HOST_EXECUTE );
+    fprintf( s->out, "  read access at address %x\n", address );
+    if( s->self_profile ) tsc_mark( s, HOST_TRACE );
+  }
+  if( word_addr >= (unsigned int)s->mem_size_in_words ) bad_address( s, address );
+  s->reg[ reg_index ] = s->mem[ word_addr ];
+  s->memory_reads++;
+  s->profile[ s->xip >> 2 ].reads++;
+  if( s->track_working_set ) ws_touch( s, &s->ws_data, address );
+  if( s->cache ) cache_ref( s, address, 0 );
+}
+
+void write_mem( struct sim88 *s, int address, int reg_index ){
+  unsigned int word_addr = (unsigned int)address >> 2;
+  s->eff_addr = address;
+  if( s->verbose ){
+    if( s->self_profile ) tsc_mark( s, HOST_EXECUTE );
+    fprintf( s->out, "  write access at address %x\n", address );
+    if( s->self_profile ) tsc_mark( s, HOST_TRACE );
+  }
+  if( word_addr >= (unsigned int)s->mem_size_in_words ) bad_address( s, address );
+  s->mem[ word_addr ] = s->reg[ reg_index ];
+  s->memory_writes++;
+  s->profile[ s->xip >> 2 ].writes++;
+  if( s->track_working_set ) ws_touch( s, &s->ws_data, address );
+  if( s->cache ) cache_ref( s, address, 1 );
+}
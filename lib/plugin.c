@@ -0,0 +1,127 @@
+/* instrumentation plugins for --plugin FILE[:ARGS], see sim_plugin.h
+ *
+ * the hooks run only in the run_hooked() instantiation of the main
+ *   loop; read_mem() and write_mem() leave the effective address in
+ *   eff_addr so that memory events can be reported after execution
+ *
+ * the host interface of plugin version 1 has no context argument, so
+ *   add_callbacks() and read_word() act on the simulator that is
+ *   current on the calling thread: the one loading the plugin, or the
+ *   one running; plugin_enter() makes a simulator current
+ */
+
+#include <string.h>
+#include <dlfcn.h>
+#include "sim88_internal.h"
+
+static __thread struct sim88 *current = NULL;
+
+void plugin_enter( struct sim88 *s ){ current = s; }
+
+int sim88_add_callbacks( struct sim88 *s, const struct sim_callbacks *cb ){
+  if( s->num_plugins == MAX_PLUGINS ) return -1;
+  s->plugins[ s->num_plugins++ ] = *cb;
+  return 0;
+}
+
+static int add_callbacks( const struct sim_callbacks *cb ){
+  return current ? sim88_add_callbacks( current, cb ) : -1;
+}
+
+static unsigned int read_word( unsigned int address ){
+  return current ? sim88_read_word( current, address ) : 0;
+}
+
+static const struct sim_host host = {
+  SIM_PLUGIN_VERSION, "mc88100", add_callbacks, read_word
+};
+
+static const struct sim_host cache_host = {
+  SIM_PLUGIN_VERSION, "mc88100-cache", add_callbacks, read_word
+};
+
+int sim88_load_plugin( struct sim88 *s, const char *spec ){
+  char path[1024];
+  const char *args = "",
+             *base = strrchr( spec, '/' ),
+             *colon = strchr( base ? base : spec, ':' );
+  void *handle;
+  sim_plugin_init_fn init;
+  int failed,
+      num_plugins = s->num_plugins;
+
+  snprintf( path, sizeof( path ), "%.*s",
+    colon ? (int)( colon - spec ) : (int)strlen( spec ), spec );
+  if( colon ) args = colon + 1;
+
+  handle = dlopen( path, RTLD_NOW | RTLD_LOCAL );
+  if( handle == NULL ){
+    fprintf( s->out, "cannot load plugin %s: %s\n", path, dlerror() );
+    return -1;
+  }
+  init = (sim_plugin_init_fn) dlsym( handle, SIM_PLUGIN_INIT );
+  plugin_enter( s );
+  failed = ( init == NULL ) || ( init( s->cache ? &cache_host : &host, args ) != 0 );
+  plugin_enter( NULL );
+  if( failed ){
+    fprintf( s->out, "plugin %s failed to initialize\n", path );
+    s->num_plugins = num_plugins; /* no callbacks into the closed plugin */
+    dlclose( handle );
+    return -1;
+  }
+  return 0;
+}
+
+void plugin_fetch( struct sim88 *s ){
+  for( int i = 0; i < s->num_plugins; i++ ){
+    if( s->plugins[ i ].fetch ) s->plugins[ i ].fetch( s->plugins[ i ].ctx, s->xip, s->ir );
+  }
+}
+
+void plugin_decode( struct sim88 *s ){
+  struct sim_decoded inst = { s->ir, s->op1, s->op2, s->d, s->s1, s->s2,
+                              s->imm16, s->scaled };
+  for( int i = 0; i < s->num_plugins; i++ ){
+    if( s->plugins[ i ].decode ) s->plugins[ i ].decode( s->plugins[ i ].ctx, s->xip, &inst );
+  }
+}
+
+/* called after the instruction executed, with the memory and taken */
+/*   branch counters as they were before it executed; a branch to the */
+/*   next word is taken too, so the target cannot tell                 */
+
+void plugin_retire( struct sim88 *s, unsigned long long reads,
+                    unsigned long long writes, unsigned long long taken ){
+  int is_write = ( s->memory_writes != writes ),
+      is_jump = ( s->op1 == 0x3d ) && ( ( s->op2 == 0x30 ) || ( s->op2 == 0x32 ) ),
+      is_branch = ( s->op1 == 0x30 ) || ( s->op1 == 0x31 ) || ( s->op1 == 0x34 )
+                  || ( s->op1 == 0x36 ) || ( s->op1 == 0x3a ) || is_jump,
+      links = ( s->op1 == 0x31 ) || ( is_jump && ( s->op2 == 0x32 ) ),
+      writes_d = !( is_branch || is_write || ( s->op1 == 0x00 ) ),
+      pair = ( ( s->op1 == 0x21 ) && ( ( s->ir >> 5 ) & 1 ) ) ? ( s->d + 1 ) & 31 : 0;
+
+  for( int i = 0; i < s->num_plugins; i++ ){
+    struct sim_callbacks *p = &s->plugins[ i ];
+    if( p->mem && ( is_write || ( s->memory_reads != reads ) ) ){
+      p->mem( p->ctx, s->xip, s->eff_addr, is_write, s->mem[ s->eff_addr >> 2 ] );
+    }
+    if( p->reg_write && writes_d && s->d ){
+      p->reg_write( p->ctx, s->xip, s->d, s->reg[ s->d ] );
+    }
+    if( p->reg_write && pair ){                /* the low word of a double */
+      p->reg_write( p->ctx, s->xip, pair, s->reg[ pair ] );
+    }
+    if( p->reg_write && links ){               /* bsr and jsr set r1 */
+      p->reg_write( p->ctx, s->xip, 1, s->reg[ 1 ] );
+    }
+    if( p->branch && is_branch ){
+      p->branch( p->ctx, s->xip, s->fip, s->taken_branches != taken );
+    }
+  }
+}
+
+void plugin_finish( struct sim88 *s, FILE *out ){
+  for( int i = 0; i < s->num_plugins; i++ ){
+    if( s->plugins[ i ].finish ) s->plugins[ i ].finish( s->plugins[ i ].ctx, out );
+  }
+}
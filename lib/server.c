@@ -0,0 +1,565 @@
+/* server mode: --serve SOCKET keeps programs and checkpoints in memory
+ *   and runs jobs sent to a unix domain socket
+ *
+ * a client sends one command per line, and every command gets one
+ *   reply, "ok N" or "error N" on a line of its own followed by N bytes;
+ *   a word that holds spaces, such as a file name, goes in double quotes
+ *
+ *   load NAME FILE [--binary]      read a program and keep it as NAME
+ *   run NAME [OPTIONS] [--save CHECKPOINT]
+ *                                  run the program or checkpoint NAME;
+ *                                  the reply is the json report, and
+ *                                  with --save the machine is kept as
+ *                                  a checkpoint to run from later
+ *   drop NAME                      forget a program or checkpoint
+ *   list                           the programs and checkpoints kept
+ *   quit                           close the connection, after the reply
+ *   shutdown                       stop the server
+ *
+ * the options of a program are those of a batch job, see batch.c, and
+ *   --limit N stops a job after N instructions, so that it can be saved
+ *   part of the way through; a checkpoint keeps its configuration, and
+ *   only --engine and --limit apply to it
+ *
+ * running a checkpoint copies it, so it can be run from again; a job
+ *   that saves a checkpoint under its own name runs it in place
+ *   instead, and keeps the threaded engine's predecoded code with it
+ *
+ * a program keeps the predecoded words of its first run on the
+ *   threaded engine, and later jobs start from them, so the program
+ *   is decoded once rather than for every job, see code_save()
+ *
+ * each connection has a thread; jobs run outside the lock on their
+ *   own contexts, so jobs from separate connections run at the same
+ *   time; the lock is held only to look up and publish entries, and a
+ *   job holds the entry it starts from while it allocates and copies
+ */
+
+#define _GNU_SOURCE   /* open_memstream, getline */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "sim88_internal.h"
+
+/* a loaded program, which the jobs running it hold as well as its */
+/*   entry, so that it can be replaced while they run               */
+
+struct program {
+  int refs;
+  unsigned int *words,
+               count;
+  struct warm_code *warm;       /* predecoded words, or NULL */
+};
+
+struct entry {
+  char *name;
+  struct program *program;      /* a program, or            */
+  struct sim88 *checkpoint;     /*   a checkpoint           */
+  unsigned long long instructions;  /* its progress, for list, */
+  int halted,                       /*   which must not read a */
+                                    /*   running checkpoint    */
+      busy,                     /* running in place by a job */
+      users;                    /* jobs starting from it     */
+};
+
+#define MAX_CLIENTS 64
+
+struct server {
+  pthread_mutex_t lock;
+  pthread_cond_t idle;          /* signalled when a client leaves */
+  struct entry *entries;
+  int num_entries, max_entries;
+  struct sim88_config defaults;
+  int binary,
+      listener,
+      stopping,
+      clients[MAX_CLIENTS],     /* connected sockets, or -1 */
+      num_clients;
+};
+
+struct client {
+  struct server *server;
+  int fd;
+};
+
+/* the entry named name, or NULL; the lock is held */
+
+static struct entry *find_entry( struct server *sv, const char *name ){
+  for( int i = 0; i < sv->num_entries; i++ ){
+    if( strcmp( sv->entries[ i ].name, name ) == 0 ) return &sv->entries[ i ];
+  }
+  return NULL;
+}
+
+static int in_use( const struct entry *e ){
+  return e->busy || e->users;
+}
+
+static void set_checkpoint( struct entry *e, struct sim88 *s ){
+  e->checkpoint = s;
+  e->instructions = s->inst_fetches;
+  e->halted = s->halt_flag;
+}
+
+/* the lock is held */
+
+static void release_program( struct program *p ){
+  if( --p->refs ) return;
+  free( p->words );
+  code_free( p->warm );
+  free( p );
+}
+
+static void clear_entry( struct entry *e ){
+  if( e->program ) release_program( e->program );
+  sim88_free( e->checkpoint );
+  e->program = NULL;
+  e->checkpoint = NULL;
+}
+
+/* the entry named name, emptied, or NULL if it is in use or cannot */
+/*   be allocated; the lock is held                                 */
+
+static struct entry *new_entry( struct server *sv, const char *name ){
+  struct entry *e = find_entry( sv, name );
+
+  if( e ){
+    if( in_use( e ) ) return NULL;
+    clear_entry( e );
+    return e;
+  }
+  if( sv->num_entries == sv->max_entries ){
+    struct entry *more = realloc( sv->entries,
+      ( sv->max_entries ? 2 * sv->max_entries : 16 ) * sizeof( struct entry ) );
+    if( more == NULL ) return NULL;
+    sv->entries = more;
+    sv->max_entries = sv->max_entries ? 2 * sv->max_entries : 16;
+  }
+  e = &sv->entries[ sv->num_entries++ ];
+  memset( e, 0, sizeof( struct entry ) );
+  e->name = strdup( name );
+  return e;
+}
+
+static int load( struct server *sv, int argc, char **words, FILE *msg ){
+  struct program *program;
+  int binary = sv->binary;
+  struct entry *e;
+  FILE *in;
+
+  if( ( argc == 4 ) && ( strcmp( words[ 3 ], "--binary" ) == 0 ) ) binary = 1;
+  else if( argc != 3 ){
+    fprintf( msg, "usage: load NAME FILE [--binary]\n" );
+    return -1;
+  }
+  program = calloc( 1, sizeof( struct program ) );
+  if( program == NULL ){
+    fprintf( msg, "cannot allocate program %s\n", words[ 1 ] );
+    return -1;
+  }
+  program->refs = 1;
+  in = fopen( words[ 2 ], binary ? "rb" : "r" );
+  if( in == NULL ){
+    fprintf( msg, "cannot open program %s\n", words[ 2 ] );
+    free( program );
+    return -1;
+  }
+  if( read_program( in, binary, &program->words, &program->count ) != 0 ){
+    fprintf( msg, "cannot read program %s\n", words[ 2 ] );
+    fclose( in );
+    free( program );
+    return -1;
+  }
+  fclose( in );
+
+  pthread_mutex_lock( &sv->lock );
+  e = new_entry( sv, words[ 1 ] );
+  if( e ) e->program = program;
+  pthread_mutex_unlock( &sv->lock );
+  if( e == NULL ){
+    fprintf( msg, "%s is in use\n", words[ 1 ] );
+    free( program->words );
+    free( program );
+    return -1;
+  }
+  fprintf( msg, "%s: %u words\n", words[ 1 ], program->count );
+  return 0;
+}
+
+/* the context a run starts from, or NULL after a message; e is a  */
+/*   copy of the entry, which the job holds, so the lock is not held; */
+/*   a program starts from warm, its predecoded words, if not NULL    */
+
+static struct sim88 *start_job( struct server *sv, const struct entry *e,
+                                const struct warm_code *warm, int argc,
+                                char **words, int in_place, FILE *msg ){
+  struct cli_options o = { .binary_input = sv->binary };
+  struct sim88 *s;
+
+  if( e->program ){
+    o.config = sv->defaults;
+    o.config.out = msg;
+    if( parse_job_options( argc, words, &o ) != 0 ) return NULL;
+    s = sim88_new( &o.config );
+    if( s && sim88_load_words( s, e->program->words, e->program->count ) ){
+      sim88_free( s );
+      return NULL;
+    }
+    if( s ) code_seed( s, warm );
+    return s;
+  }
+
+  s = e->checkpoint;
+  o.config = s->config;
+  o.config.out = msg;
+  o.config.inst_limit = 0;
+  if( parse_job_options( argc, words, &o ) != 0 ) return NULL;
+  if( ( o.config.cache != s->config.cache )
+      || ( o.config.mem_size_in_words != s->config.mem_size_in_words )
+      || ( o.config.profiling != s->config.profiling )
+      || ( o.config.self_profile != s->config.self_profile )
+      || ( o.config.lockstep_every != s->config.lockstep_every ) ){
+    fprintf( msg, "only --engine and --limit apply to a checkpoint\n" );
+    return NULL;
+  }
+
+  if( !in_place ) s = sim88_copy( s );
+  if( s ){
+    sim88_set_output( s, msg );
+    s->config.engine = o.config.engine;
+    s->config.inst_limit = o.config.inst_limit;
+    clock_gettime( CLOCK_MONOTONIC, &s->start_time );
+  }
+  return s;
+}
+
+static int run( struct server *sv, int argc, char **words, FILE *msg ){
+  const char *save = NULL;
+  struct entry *e, from;
+  struct program *program = NULL;
+  struct warm_code *warm = NULL,
+                   *saved = NULL;
+  struct sim88 *s,
+               *discard = NULL;
+  int in_place = 0,
+      held = 0,
+      failed;
+
+  /* take --save out of the options */
+  for( int i = 2; i < argc; i++ ){
+    if( ( strcmp( words[ i ], "--save" ) == 0 ) && ( i + 1 < argc ) ){
+      save = words[ i + 1 ];
+      memmove( &words[ i ], &words[ i + 2 ], ( argc - i - 2 ) * sizeof( char * ) );
+      argc -= 2;
+      break;
+    }
+  }
+  if( argc < 2 ){
+    fprintf( msg, "usage: run NAME [OPTIONS] [--save CHECKPOINT]\n" );
+    return -1;
+  }
+
+  /* hold the entry: a program by a reference for the whole job, a */
+  /*   checkpoint as busy to run it in place, or as a user to start  */
+  /*   from a copy of it                                             */
+  pthread_mutex_lock( &sv->lock );
+  e = find_entry( sv, words[ 1 ] );
+  if( e == NULL ) fprintf( msg, "no program or checkpoint %s\n", words[ 1 ] );
+  else if( e->program ){
+    program = e->program;
+    program->refs++;
+    warm = program->warm;
+    held = 1;
+  }else if( e->busy ) fprintf( msg, "checkpoint %s is running\n", e->name );
+  else if( save && ( strcmp( save, e->name ) == 0 ) ){
+    if( e->users ) fprintf( msg, "checkpoint %s is in use\n", e->name );
+    else in_place = held = e->busy = 1;
+  }else{
+    e->users++;
+    held = 1;
+  }
+  if( held ) from = *e;
+  pthread_mutex_unlock( &sv->lock );
+  if( !held ) return -1;
+
+  s = start_job( sv, &from, warm, argc - 1, words + 1, in_place, msg );
+  if( ( s == NULL ) || ( !program && !in_place ) ){
+    pthread_mutex_lock( &sv->lock );
+    if( program ) release_program( program );
+    else{
+      e = find_entry( sv, words[ 1 ] );
+      if( in_place ) e->busy = 0;
+      else e->users--;
+    }
+    pthread_mutex_unlock( &sv->lock );
+  }
+  if( s == NULL ) return -1;
+
+  failed = sim88_run( s );
+  if( !failed ) sim88_report( s, SIM88_STATS_JSON );
+  sim88_set_output( s, NULL );
+  if( program && ( warm == NULL ) && !failed ){
+    saved = code_save( s, program->words, program->count );
+  }
+
+  pthread_mutex_lock( &sv->lock );
+  if( program ){
+    if( saved && ( program->warm == NULL ) ){
+      program->warm = saved;
+      saved = NULL;
+    }
+    release_program( program );
+  }
+  if( in_place ){
+    e = find_entry( sv, save );
+    e->busy = 0;
+    if( failed ){                 /* the state is the failure's */
+      clear_entry( e );
+      free( e->name );
+      *e = sv->entries[ --sv->num_entries ];
+    }else{
+      set_checkpoint( e, s );
+    }
+  }else if( save && !failed ){
+    e = new_entry( sv, save );
+    if( e ) set_checkpoint( e, s );
+    else{
+      discard = s;
+      failed = 1;
+      fprintf( msg, "checkpoint %s is in use\n", save );
+    }
+  }else{
+    discard = s;
+  }
+  pthread_mutex_unlock( &sv->lock );
+  code_free( saved );             /* another job saved its words first */
+  sim88_free( discard );
+  return failed ? -1 : 0;
+}
+
+static int drop( struct server *sv, int argc, char **words, FILE *msg ){
+  struct entry *e;
+  int failed = 0;
+
+  if( argc != 2 ){
+    fprintf( msg, "usage: drop NAME\n" );
+    return -1;
+  }
+  pthread_mutex_lock( &sv->lock );
+  e = find_entry( sv, words[ 1 ] );
+  if( e == NULL ){
+    fprintf( msg, "no program or checkpoint %s\n", words[ 1 ] );
+    failed = 1;
+  }else if( in_use( e ) ){
+    fprintf( msg, "%s is %s\n", words[ 1 ], e->busy ? "running" : "in use" );
+    failed = 1;
+  }else{
+    clear_entry( e );
+    free( e->name );
+    *e = sv->entries[ --sv->num_entries ];
+  }
+  pthread_mutex_unlock( &sv->lock );
+  return failed ? -1 : 0;
+}
+
+static void list( struct server *sv, FILE *msg ){
+  pthread_mutex_lock( &sv->lock );
+  for( int i = 0; i < sv->num_entries; i++ ){
+    struct entry *e = &sv->entries[ i ];
+    if( e->program ){
+      fprintf( msg, "program %s %u words\n", e->name, e->program->count );
+    }else{
+      fprintf( msg, "checkpoint %s %llu instructions%s%s\n", e->name,
+        e->instructions, e->halted ? " halted" : "",
+        e->busy ? " running" : "" );
+    }
+  }
+  pthread_mutex_unlock( &sv->lock );
+}
+
+/* the words of line, split in place; -1 if a quote is not closed */
+
+static int split_words( char *line, char **words ){
+  const char *space = " \t\r\n";
+  char *p = line;
+  int argc = 0;
+
+  for( ;; ){
+    p += strspn( p, space );
+    if( *p == '\0' ) return argc;
+    if( *p == '"' ){
+      words[ argc++ ] = ++p;
+      p = strchr( p, '"' );
+      if( p == NULL ) return -1;
+    }else{
+      words[ argc++ ] = p;
+      p += strcspn( p, space );
+      if( *p == '\0' ) return argc;
+    }
+    *p++ = '\0';
+  }
+}
+
+static void reply( FILE *out, int ok, const char *body, size_t size ){
+  fprintf( out, "%s %zu\n", ok ? "ok" : "error", size );
+  fwrite( body, 1, size, out );
+  fflush( out );
+}
+
+static void *serve_client( void *arg ){
+  struct client *c = arg;
+  struct server *sv = c->server;
+  FILE *in = fdopen( c->fd, "r" ),
+       *out = fdopen( dup( c->fd ), "w" );
+  char *line = NULL,
+       **words = NULL,
+       *body;
+  size_t line_size = 0, size;
+  ssize_t length;
+
+  while( in && out && ( ( length = getline( &line, &line_size, in ) ) >= 0 ) ){
+    FILE *msg;
+    int argc,
+        ok = 1,
+        quit = 0,
+        stop = 0;
+
+    words = realloc( words, ( length / 2 + 2 ) * sizeof( char * ) );
+    if( words == NULL ) break;
+    argc = split_words( line, words );
+    if( argc == 0 ) continue;
+
+    body = NULL;
+    msg = open_memstream( &body, &size );
+    if( msg == NULL ) break;
+    if( argc < 0 ){
+      fprintf( msg, "a quote is not closed\n" );
+      ok = 0;
+    }
+    else if( strcmp( words[ 0 ], "quit" ) == 0 ) quit = 1;
+    else if( strcmp( words[ 0 ], "load" ) == 0 ) ok = !load( sv, argc, words, msg );
+    else if( strcmp( words[ 0 ], "run" ) == 0 ) ok = !run( sv, argc, words, msg );
+    else if( strcmp( words[ 0 ], "drop" ) == 0 ) ok = !drop( sv, argc, words, msg );
+    else if( strcmp( words[ 0 ], "list" ) == 0 ) list( sv, msg );
+    else if( strcmp( words[ 0 ], "shutdown" ) == 0 ) stop = 1;
+    else{
+      fprintf( msg, "unknown command %s\n", words[ 0 ] );
+      ok = 0;
+    }
+    fclose( msg );
+    reply( out, ok, body, size );
+    free( body );
+    if( quit ) break;
+    if( stop ){                   /* after the reply, which it would cut off */
+      pthread_mutex_lock( &sv->lock );
+      sv->stopping = 1;
+      shutdown( sv->listener, SHUT_RDWR );
+      pthread_mutex_unlock( &sv->lock );
+      break;
+    }
+  }
+  free( line );
+  free( words );
+  if( in ) fclose( in );
+  if( out ) fclose( out );
+
+  pthread_mutex_lock( &sv->lock );
+  for( int i = 0; i < MAX_CLIENTS; i++ ){
+    if( sv->clients[ i ] == c->fd ) sv->clients[ i ] = -1;
+  }
+  sv->num_clients--;
+  pthread_cond_signal( &sv->idle );
+  pthread_mutex_unlock( &sv->lock );
+  free( c );
+  return NULL;
+}
+
+int sim88_serve( const char *path, const struct sim88_config *defaults,
+                 int binary ){
+  struct server sv = { .defaults = *defaults, .binary = binary };
+  struct sockaddr_un address = { .sun_family = AF_UNIX };
+  struct stat st;
+  pthread_t id;
+
+  if( strlen( path ) >= sizeof( address.sun_path ) ){
+    printf( "socket name %s is too long\n", path );
+    return -1;
+  }
+  strcpy( address.sun_path, path );
+  if( ( stat( path, &st ) == 0 ) && S_ISSOCK( st.st_mode ) ) unlink( path );
+  sv.listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( ( sv.listener < 0 )
+      || bind( sv.listener, (struct sockaddr *)&address, sizeof( address ) )
+      || listen( sv.listener, 16 ) ){
+    printf( "cannot listen on %s: %s\n", path, strerror( errno ) );
+    return -1;
+  }
+  signal( SIGPIPE, SIG_IGN );     /* a client that goes away is not fatal */
+  pthread_mutex_init( &sv.lock, NULL );
+  pthread_cond_init( &sv.idle, NULL );
+  for( int i = 0; i < MAX_CLIENTS; i++ ) sv.clients[ i ] = -1;
+  printf( "serving on %s\n", path );
+  fflush( stdout );
+
+  for( ;; ){
+    int fd = accept( sv.listener, NULL, NULL );
+    struct client *c;
+
+    if( fd < 0 ){
+      int stopping;
+      pthread_mutex_lock( &sv.lock );
+      stopping = sv.stopping;
+      pthread_mutex_unlock( &sv.lock );
+      if( stopping ) break;
+      if( errno == EINTR ) continue;
+      printf( "cannot accept on %s: %s\n", path, strerror( errno ) );
+      break;
+    }
+    pthread_mutex_lock( &sv.lock );
+    if( sv.num_clients == MAX_CLIENTS ){
+      pthread_mutex_unlock( &sv.lock );
+      close( fd );
+      continue;
+    }
+    for( int i = 0; i < MAX_CLIENTS; i++ ){
+      if( sv.clients[ i ] < 0 ){
+        sv.clients[ i ] = fd;
+        break;
+      }
+    }
+    sv.num_clients++;
+    pthread_mutex_unlock( &sv.lock );
+
+    c = malloc( sizeof( struct client ) );
+    c->server = &sv;
+    c->fd = fd;
+    if( pthread_create( &id, NULL, serve_client, c ) != 0 ){
+      printf( "cannot start a client thread\n" );
+      exit( -1 );
+    }
+    pthread_detach( id );
+  }
+
+  /* wake the clients still connected and wait for them to leave */
+  pthread_mutex_lock( &sv.lock );
+  for( int i = 0; i < MAX_CLIENTS; i++ ){
+    if( sv.clients[ i ] >= 0 ) shutdown( sv.clients[ i ], SHUT_RDWR );
+  }
+  while( sv.num_clients ) pthread_cond_wait( &sv.idle, &sv.lock );
+  pthread_mutex_unlock( &sv.lock );
+
+  close( sv.listener );
+  unlink( path );
+  for( int i = 0; i < sv.num_entries; i++ ){
+    clear_entry( &sv.entries[ i ] );
+    free( sv.entries[ i ].name );
+  }
+  free( sv.entries );
+  return 0;
+}
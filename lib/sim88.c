@@ -0,0 +1,169 @@
+/* simulator contexts: configuration, creation, running a program, and
+ *   reading the results
+ *
+ * a program error anywhere in a run calls sim88_fail(), which writes
+ *   the message and returns to sim88_run() through the context's
+ *   jmp_buf, so the handlers need no error paths of their own
+ */
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "sim88_internal.h"
+
+void sim88_config_init( struct sim88_config *config ){
+  memset( config, 0, sizeof( struct sim88_config ) );
+  config->mem_size_in_words = SIM88_MEM_SIZE_IN_WORDS;
+  config->engine = SIM88_ENGINE_SWITCH;
+  config->interval_name = "intervals.csv";
+  config->out = stdout;
+}
+
+struct sim88 *sim88_new( const struct sim88_config *config ){
+  struct sim88 *s = calloc( 1, sizeof( struct sim88 ) );
+
+  if( s == NULL ) return NULL;
+  clock_gettime( CLOCK_MONOTONIC, &s->start_time );
+  s->config = *config;
+  s->out = config->out ? config->out : stdout;
+  s->mem_size_in_words = config->mem_size_in_words;
+  s->verbose = config->trace_level;
+  s->self_profile = config->self_profile;
+  s->run_limit = ~0ULL;
+  s->ws_epoch = 1;
+  s->next_interval = ~0ULL;
+  if( mem_alloc( s ) != 0 ){
+    sim88_free( s );
+    return NULL;
+  }
+  if( config->cache ){
+    s->cache = malloc( sizeof( struct cache ) );
+    if( s->cache == NULL ){
+      sim88_free( s );
+      return NULL;
+    }
+    cache_init( s->cache );
+  }
+  return s;
+}
+
+void sim88_free( struct sim88 *s ){
+  if( s == NULL ) return;
+  engine_free( s );
+  if( s->interval_file ) fclose( s->interval_file );
+  ws_free( &s->ws_inst );
+  ws_free( &s->ws_data );
+  free( s->cache );
+  mem_free( s );
+  free( s );
+}
+
+void sim88_fail( struct sim88 *s, const char *format, ... ){
+  va_list args;
+
+  va_start( args, format );
+  vfprintf( s->out, format, args );
+  va_end( args );
+  longjmp( s->fail, 1 );
+}
+
+/* the threaded engine runs when nothing needs the hooks and the */
+/*   per-instruction bookkeeping of the switch engine; it keeps   */
+/*   its predecoded code for the next run, which the switch       */
+/*   engine would leave stale by storing to memory; the report    */
+/*   names the engine that ran, not the one configured            */
+
+int sim88_run( struct sim88 *s ){
+  const struct sim88_config *c = &s->config;
+  int fast = ( c->engine == SIM88_ENGINE_THREADED ) && !c->lockstep_every
+             && !c->inst_limit && !s->verbose && !c->profiling
+             && !c->interval_length && !s->self_profile && !s->num_plugins;
+
+  if( setjmp( s->fail ) ){
+    plugin_enter( NULL );
+    s->run_limit = ~0ULL;
+    engine_free( s );
+    return -1;
+  }
+
+  if( !fast ) engine_free( s );
+  s->engine_used = fast ? "threaded"
+                 : ( c->lockstep_every && !c->inst_limit ) ? "lockstep"
+                 : "switch";
+  if( c->interval_length ) interval_init( s );
+  if( s->verbose ) fprintf( s->out, "instruction trace:\n" );
+  s->last_tick = read_ticks();
+  plugin_enter( s );
+  if( fast ) run_fast( s );
+  else if( c->inst_limit ){
+    s->run_limit = s->inst_fetches + c->inst_limit;
+    run_hooked( s );
+    s->run_limit = ~0ULL;
+  }
+  else if( c->lockstep_every ) run_lockstep( s );
+  else if( s->num_plugins ) run_hooked( s );
+  else run_plain( s );
+  plugin_enter( NULL );
+
+  if( s->self_profile ) tsc_mark( s, HOST_TRACE );
+  if( c->interval_length ) interval_finish( s );
+
+  if( s->verbose ) fprintf( s->out, "\n" );
+  lockstep_free( s );
+  return 0;
+}
+
+struct sim88 *sim88_copy( const struct sim88 *s ){
+  struct sim88 *c = sim88_new( &s->config );
+
+  if( c == NULL ) return NULL;
+  c->config.out = c->out = s->out;
+  memcpy( c->mem, s->mem, s->mem_size_in_words * sizeof( int ) );
+  if( s->config.profiling ){      /* otherwise it is never reported */
+    memcpy( c->profile, s->profile,
+      s->mem_size_in_words * sizeof( struct pc_profile ) );
+  }
+  memcpy( c->reg, s->reg, sizeof( s->reg ) );
+  c->xip = s->xip;
+  c->fip = s->fip;
+  c->halt_flag = s->halt_flag;
+  c->inst_fetches = s->inst_fetches;
+  c->memory_reads = s->memory_reads;
+  c->memory_writes = s->memory_writes;
+  c->branches = s->branches;
+  c->taken_branches = s->taken_branches;
+  memcpy( c->op_counts, s->op_counts, sizeof( s->op_counts ) );
+  memcpy( c->host_ticks, s->host_ticks, sizeof( s->host_ticks ) );
+  if( s->cache ) *c->cache = *s->cache;
+  c->lockstep_checks = s->lockstep_checks;
+  c->engine_used = s->engine_used;
+  return c;
+}
+
+void sim88_set_output( struct sim88 *s, FILE *out ){
+  s->config.out = s->out = out ? out : stdout;
+}
+
+void sim88_get_counters( const struct sim88 *s, struct sim88_counters *c ){
+  memset( c, 0, sizeof( struct sim88_counters ) );
+  c->inst_fetches = s->inst_fetches;
+  c->memory_reads = s->memory_reads;
+  c->memory_writes = s->memory_writes;
+  c->branches = s->branches;
+  c->taken_branches = s->taken_branches;
+  if( s->cache ){
+    c->cache_reads = s->cache->reads;
+    c->cache_writes = s->cache->writes;
+    c->cache_hits = s->cache->hits;
+    c->cache_misses = s->cache->misses;
+    c->cache_write_backs = s->cache->write_backs;
+  }
+}
+
+unsigned int sim88_get_reg( const struct sim88 *s, int r ){
+  return ( ( r >= 0 ) && ( r < 32 ) ) ? (unsigned int)s->reg[ r ] : 0;
+}
+
+int sim88_halted( const struct sim88 *s ){
+  return s->halt_flag;
+}
@@ -0,0 +1,162 @@
+/* MC88100 subset simulator library
+ *
+ * a struct sim88 is one simulated machine: the processor state, its
+ *   memory, an optional data cache, the statistics, and any plugins;
+ *   contexts share nothing, so separate contexts may run at the same
+ *   time on separate threads
+ *
+ * modules
+ *
+ *   core.c      decode, the instruction handlers and the switch engine
+ *   threaded.c  the predecoded threaded engine and --lockstep
+ *   memory.c    the memory backend: allocation, loading, and bounds
+ *   cache.c     the data cache model
+ *   stats.c     statistics, reports, intervals and working sets
+ *   plugin.c    instrumentation plugins, see plugins/sim_plugin.h
+ *   sim88.c     contexts, configuration, and running a program
+ *   batch.c     many programs and configurations on a thread pool
+ *   server.c    programs and checkpoints kept by a socket server
+ *   cli.c       the command line shared by both simulator programs
+ *
+ * sim88.hpp wraps this interface in C++ classes
+ *
+ * typical use
+ *
+ *   struct sim88_config config;
+ *   struct sim88 *s;
+ *
+ *   sim88_config_init( &config );
+ *   config.cache = 1;
+ *   s = sim88_new( &config );
+ *   if( ( s == NULL ) || sim88_load( s, stdin, 0 ) ) ...
+ *   if( sim88_run( s ) == 0 ) sim88_report( s, SIM88_STATS_JSON );
+ *   sim88_free( s );
+ *
+ * errors are written to config.out with the same messages that the
+ *   simulator programs print, and the functions return nonzero; a
+ *   program error (an unknown instruction or an address outside the
+ *   memory) stops sim88_run() but leaves the context to be inspected
+ */
+
+#ifndef SIM88_H
+#define SIM88_H
+
+#include <stdio.h>
+#include "../plugins/sim_plugin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM88_MEM_SIZE_IN_WORDS    ( 256 * 1024 )   /* 1 MiB */
+#define SIM88_MAX_MEM_SIZE_IN_MIB  2048
+
+enum sim88_engine { SIM88_ENGINE_SWITCH, SIM88_ENGINE_THREADED };
+
+enum sim88_format { SIM88_STATS_TEXT, SIM88_STATS_JSON, SIM88_STATS_CSV };
+
+struct sim88_config {
+  int mem_size_in_words,        /* default SIM88_MEM_SIZE_IN_WORDS     */
+      cache,                    /* model the data cache                */
+      trace_level,              /* 0, 1 for -t, 2 for -v               */
+      profiling,                /* per-instruction profile, -p         */
+      show_mix,                 /* instruction mix in the text report  */
+      self_profile;             /* time the simulator itself           */
+  enum sim88_engine engine;     /* used when nothing needs the switch  */
+                                /*   engine, see sim88_run()           */
+  unsigned long long
+      lockstep_every,           /* N of --lockstep, or 0               */
+      interval_length,          /* N of --interval, or 0               */
+      inst_limit;               /* N of --limit: each sim88_run() stops */
+                                /*   after N more instructions, on the  */
+                                /*   switch engine; 0 for no limit      */
+  const char *interval_name;    /* default intervals.csv               */
+  FILE *out;                    /* traces, reports, errors; stdout     */
+};
+
+/* every counter of a run, for callers that want numbers, not text */
+
+struct sim88_counters {
+  unsigned long long inst_fetches,
+                     memory_reads,
+                     memory_writes,
+                     branches,
+                     taken_branches,
+                     cache_reads,      /* the cache counters are 0 */
+                     cache_writes,     /*   without a cache        */
+                     cache_hits,
+                     cache_misses,
+                     cache_write_backs;
+};
+
+struct sim88;
+
+void sim88_config_init( struct sim88_config *config );
+
+/* NULL if the memory cannot be allocated */
+
+struct sim88 *sim88_new( const struct sim88_config *config );
+void sim88_free( struct sim88 *s );
+
+/* load the program at address 0, as hex words or as big-endian binary */
+/*   words; nonzero if it does not fit in the memory                    */
+
+int sim88_load( struct sim88 *s, FILE *in, int binary );
+int sim88_load_words( struct sim88 *s, const unsigned int *words,
+                      unsigned int count );
+
+/* instrumentation: a plugin FILE[:ARGS], or callbacks from the caller */
+
+int sim88_load_plugin( struct sim88 *s, const char *spec );
+int sim88_add_callbacks( struct sim88 *s, const struct sim_callbacks *cb );
+
+/* run the program until it halts or reaches the limit; nonzero on a */
+/*   program error; a program that has not halted may be run again    */
+
+int sim88_run( struct sim88 *s );
+
+/* a checkpoint: a new context in the state of s, with its memory, */
+/*   registers, counters, and cache, but no plugins; NULL if the   */
+/*   memory cannot be allocated                                    */
+
+struct sim88 *sim88_copy( const struct sim88 *s );
+
+/* where traces, reports, and errors go from now on */
+
+void sim88_set_output( struct sim88 *s, FILE *out );
+
+/* results */
+
+void sim88_get_counters( const struct sim88 *s, struct sim88_counters *c );
+unsigned int sim88_get_reg( const struct sim88 *s, int r );
+unsigned int sim88_read_word( const struct sim88 *s, unsigned int address );
+int sim88_halted( const struct sim88 *s );
+
+/* the statistics in the format of the simulator programs, followed */
+/*   by the plugin reports; with json and csv the plugin reports go */
+/*   to stderr, so that the output stays one document               */
+
+void sim88_report( struct sim88 *s, enum sim88_format format );
+
+/* run every job of a batch manifest on a pool of threads (0 for one */
+/*   per processor) and write the results to out as one json document; */
+/*   nonzero if the manifest is wrong or any job failed, see batch.c    */
+
+int sim88_batch( const char *manifest, const struct sim88_config *defaults,
+                 int binary, int threads, FILE *out );
+
+/* serve jobs on a unix domain socket until a client sends shutdown, */
+/*   see server.c; nonzero if the socket cannot be set up             */
+
+int sim88_serve( const char *path, const struct sim88_config *defaults,
+                 int binary );
+
+/* the whole command line of a simulator program */
+
+int sim88_main( int argc, char **argv, int cache );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
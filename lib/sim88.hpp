@@ -0,0 +1,97 @@
+/* C++ interface to the MC88100 subset simulator library, see sim88.h
+ *
+ * a mc88::Simulator owns one context; failures that the C interface
+ *   reports with a nonzero return throw mc88::Error, whose message is
+ *   the one the simulator wrote to config.out
+ *
+ *   mc88::Config config;
+ *   config.cache = 1;
+ *   mc88::Simulator sim( config );
+ *   sim.load( words );
+ *   sim.run();
+ *   std::cout << sim.counters().inst_fetches << "\n";
+ */
+
+#ifndef SIM88_HPP
+#define SIM88_HPP
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "sim88.h"
+
+namespace mc88 {
+
+class Error : public std::runtime_error {
+public:
+  explicit Error( const std::string &what ) : std::runtime_error( what ) {}
+};
+
+struct Config : sim88_config {
+  Config() { sim88_config_init( this ); }
+};
+
+typedef sim88_counters Counters;
+
+class Simulator {
+public:
+  explicit Simulator( const Config &config = Config() )
+    : s_( sim88_new( &config ) ) {
+    if( s_ == nullptr ) throw Error( "cannot create the simulator" );
+  }
+  ~Simulator() { sim88_free( s_ ); }
+
+  Simulator( const Simulator & ) = delete;
+  Simulator &operator=( const Simulator & ) = delete;
+  Simulator( Simulator &&other ) noexcept : s_( other.s_ ) { other.s_ = nullptr; }
+  Simulator &operator=( Simulator &&other ) noexcept {
+    std::swap( s_, other.s_ );
+    return *this;
+  }
+
+  void load( std::FILE *in, bool binary = false ) {
+    if( sim88_load( s_, in, binary ) != 0 ) throw Error( "too many words loaded" );
+  }
+  void load( const std::vector<unsigned int> &words ) {
+    if( sim88_load_words( s_, words.data(), words.size() ) != 0 ){
+      throw Error( "too many words loaded" );
+    }
+  }
+  void load_plugin( const std::string &spec ) {
+    if( sim88_load_plugin( s_, spec.c_str() ) != 0 ){
+      throw Error( "cannot load plugin " + spec );
+    }
+  }
+  void add_callbacks( const sim_callbacks &cb ) {
+    if( sim88_add_callbacks( s_, &cb ) != 0 ) throw Error( "too many plugins" );
+  }
+
+  /* a program error leaves the state as it was when the error occurred */
+
+  void run() {
+    if( sim88_run( s_ ) != 0 ) throw Error( "program error" );
+  }
+
+  Counters counters() const {
+    Counters c;
+    sim88_get_counters( s_, &c );
+    return c;
+  }
+  unsigned int reg( int r ) const { return sim88_get_reg( s_, r ); }
+  unsigned int read_word( unsigned int address ) const {
+    return sim88_read_word( s_, address );
+  }
+  bool halted() const { return sim88_halted( s_ ) != 0; }
+  void report( sim88_format format = SIM88_STATS_TEXT ) { sim88_report( s_, format ); }
+
+  struct sim88 *get() { return s_; }
+
+private:
+  struct sim88 *s_;
+};
+
+}  // namespace mc88
+
+#endif
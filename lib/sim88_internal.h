@@ -0,0 +1,379 @@
+/* state of a simulated machine and the functions the library modules */
+/*   share; not part of the interface in sim88.h                       */
+
+#ifndef SIM88_INTERNAL_H
+#define SIM88_INTERNAL_H
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <time.h>
+#include "sim88.h"
+
+/* dynamic instruction mix, counted in the dispatch switch of run()   */
+/*   the register forms of ld, st, and lda are each followed by their */
+/*   scaled form so that the scaled bit can index the counter; the     */
+/*   logical operations follow their op1 and op2 codes, 0x10 to 0x17   */
+
+enum {
+  OP_HALT,
+  OP_IMM_LD, OP_IMM_ST, OP_IMM_LDA, OP_IMM_ADD, OP_IMM_SUB,
+  OP_BR, OP_BCND,
+  OP_EXT, OP_EXTU, OP_MAK, OP_ROT,
+  OP_LD, OP_LD_SCALED, OP_ST, OP_ST_SCALED, OP_LDA, OP_LDA_SCALED,
+  OP_ADD, OP_SUB,
+  OP_IMM_AND, OP_IMM_AND_U, OP_IMM_MASK, OP_IMM_MASK_U,
+  OP_IMM_XOR, OP_IMM_XOR_U, OP_IMM_OR, OP_IMM_OR_U,
+  OP_AND, OP_AND_C, OP_XOR, OP_XOR_C, OP_OR, OP_OR_C,
+  OP_IMM_MUL, OP_IMM_DIV, OP_IMM_DIVU, OP_MUL, OP_DIV, OP_DIVU,
+  OP_BSR, OP_JMP, OP_JSR,
+  OP_IMM_CMP, OP_CMP, OP_BB0, OP_BB1,
+  OP_FADD, OP_FSUB, OP_FMUL, OP_FDIV, OP_FLT, OP_INT,
+  NUM_OPS
+};
+
+extern const char *op_names[NUM_OPS],   /* for the text report     */
+                  *op_keys[NUM_OPS];    /* for json and csv output */
+
+/* per-instruction execution profile, kept densely by word address */
+/*   so that attributing an event costs a single increment          */
+
+struct pc_profile {
+  unsigned long long
+               execs,   /* times the instruction was executed       */
+               taken,   /* times the branch at this address was taken */
+               reads,   /* data words read by the instruction       */
+               writes,  /* data words written by the instruction    */
+               misses;  /* data cache misses caused by the instruction */
+};
+
+/* data cache, see cache.c */
+
+#define LINES_PER_BANK 64
+
+struct cache {
+  unsigned int valid[2][LINES_PER_BANK],    /* valid bit for each line    */
+               dirty[2][LINES_PER_BANK],    /* dirty bit for each line    */
+               tag[2][LINES_PER_BANK],      /* tag bits for each line     */
+               lru[LINES_PER_BANK];
+  unsigned long long reads,                 /* counters */
+                     writes,
+                     hits,
+                     misses,
+                     write_backs;
+};
+
+void cache_init( struct cache *c );
+unsigned int cache_access( struct cache *c, unsigned int address,
+                           unsigned int type );
+void cache_stats( const struct cache *c, FILE *out );
+
+/* host-side self profile phases, see tsc_mark() */
+
+enum {
+  HOST_FETCH,     /* fetch and decode                        */
+  HOST_EXECUTE,   /* dispatch and instruction handlers       */
+  HOST_CACHE,     /* data cache model                        */
+  HOST_TRACE,     /* -t and -v output                        */
+  HOST_OTHER,     /* interval snapshots                      */
+  NUM_HOST_PHASES
+};
+
+/* working-set size for --interval, see stats.c */
+
+struct working_set {
+  unsigned int *line_epoch,            /* interval that last touched it */
+               *page_epoch;
+  unsigned char *line_seen,            /* touched at any time in the run */
+                *page_seen;
+  unsigned long long lines, pages,     /* distinct in this interval */
+                     total_lines, total_pages;
+};
+
+struct snapshot {
+  unsigned long long fetches, reads, writes, branches, taken,
+                     hits, misses, write_backs;
+};
+
+/* machine-readable statistics, see stats.c */
+
+#define MAX_STATS 128
+
+struct stat_entry {
+  const char *section,
+             *name;
+  char value[32];
+  int is_string;
+};
+
+/* store log of an engine, for --lockstep */
+
+struct write_log {
+  unsigned int *entries,    /* address and value of every store */
+               count,       /* stores in the log */
+               max;
+};
+
+#define MAX_PLUGINS 8
+#define LOCKSTEP_HISTORY 16
+
+struct sim88 {
+  struct sim88_config config;
+  FILE *out;
+
+  /* memory; since the simulation deals only with one-word instructions */
+  /*   and one-word operands, we represent memory as an array of words   */
+
+  int *mem,
+      mem_size_in_words;
+
+  /* processor state, simulation state, and instruction fields    */
+
+  int reg[32],   /* general register set, r0 is always 0    */
+      xip,       /* execute instruction pointer             */
+      fip,       /* fetch instruction pointer               */
+      halt_flag, /* set by halt instruction                 */
+      verbose,   /* governs amount of detail in output      */
+      ir,        /* 32-bit instruction register             */
+      op1,       /* 6-bit primary opcode in bits 31 to 27   */
+      op2,       /* 6-bit secondary opcode in bits 15 to 10 */
+      d,         /* 5-bit destination register identifier   */
+      s1,        /* 5-bit source 1 register identifier      */
+      s2,        /* 5-bit source 2 register identifier      */
+      imm16,     /* 16-bit immediate field                  */
+      scaled,    /* scaled addressing mode bit 9            */
+      eff_addr;  /* 32-bit effective address                */
+
+  /* dynamic execution statistics */
+
+  unsigned long long inst_fetches,
+                     memory_reads,
+                     memory_writes,
+                     branches,
+                     taken_branches,
+                     op_counts[NUM_OPS];
+  struct pc_profile *profile;      /* mem_size_in_words entries */
+
+  struct cache *cache;             /* or NULL */
+
+  /* self profile */
+
+  int self_profile;
+  unsigned long long host_ticks[NUM_HOST_PHASES],
+                     last_tick;
+
+  /* plugins */
+
+  struct sim_callbacks plugins[MAX_PLUGINS];
+  int num_plugins;
+
+  /* intervals and working sets */
+
+  struct working_set ws_inst, ws_data;
+  int track_working_set;
+  unsigned int ws_epoch;           /* 0 marks a line never touched */
+  unsigned long long next_interval,  /* fetch count of the next snapshot */
+                     interval_count;
+  FILE *interval_file;
+  struct snapshot last_snapshot;
+
+  /* statistics for json and csv */
+
+  struct stat_entry stat_list[MAX_STATS];
+  int num_stats;
+  struct timespec start_time;      /* host wall clock at sim88_new() */
+  const char *engine_used;         /* by the last sim88_run(), or NULL */
+
+  /* lockstep */
+
+  unsigned long long run_limit,    /* the hooked loop stops here */
+                     lockstep_checks,
+                     lockstep_fetched;
+  unsigned int lockstep_pcs[LOCKSTEP_HISTORY];  /* latest reference xips */
+  struct write_log lockstep_writes;             /* stores of the reference */
+  void *lockstep_shadow,           /* the threaded engine's machine */
+       *fast_code;                 /*   and predecoded code, or NULL */
+
+  jmp_buf fail;                    /* set by sim88_run() */
+};
+
+/* sim88.c */
+
+void sim88_fail( struct sim88 *s, const char *format, ... )
+  __attribute__(( noreturn, format( printf, 2, 3 ) ));
+
+/* core.c */
+
+void decode( struct sim88 *s );
+void disasm( struct sim88 *s, char *buf );
+void unknown_op( struct sim88 *s ) __attribute__(( noreturn ));
+void divide_by_zero( struct sim88 *s ) __attribute__(( noreturn ));
+void conversion_overflow( struct sim88 *s ) __attribute__(( noreturn ));
+void run_plain( struct sim88 *s );
+void run_hooked( struct sim88 *s );
+
+/* the quotient of div; the MC88100 traps on a negative operand so */
+/*   that software can finish the division, and this is the result  */
+/*   it leaves, truncated toward zero; -2^31 / -1 wraps              */
+
+static inline int quotient( int a, int b ){
+  return ( b == -1 ) ? (int)-(unsigned int)a : a / b;
+}
+
+/* the bit string of cmp: bits 2 to 11 are eq, ne, gt, le, lt, ge, */
+/*   signed, then hi, ls, lo, hs, unsigned; the others are zero     */
+
+static inline unsigned int compare( int a, int b ){
+  unsigned int ua = a, ub = b;
+  return ( ( a == b ) << 2 ) | ( ( a != b ) << 3 )
+       | ( ( a > b ) << 4 ) | ( ( a <= b ) << 5 )
+       | ( ( a < b ) << 6 ) | ( ( a >= b ) << 7 )
+       | ( ( ua > ub ) << 8 ) | ( ( ua <= ub ) << 9 )
+       | ( ( ua < ub ) << 10 ) | ( ( ua >= ub ) << 11 );
+}
+
+/* floating point, op1 0x21; the size fields T1, T2, and TD of the */
+/*   instruction are 0 for single and 1 for double; a single is one  */
+/*   register, and a double the pair rN, rN + 1 with the high word in */
+/*   rN (the pair of r31 is r31 and r0)                               */
+
+static inline int fp_valid( unsigned int ir ){
+  unsigned int types = ( ir >> 5 ) & 0x3f;    /* T1, T2, TD, in bits 10 to 5 */
+
+  if( types & 0x2a ) return 0;                /* not single or double */
+  switch( ( ir >> 11 ) & 0x1f ){
+    case 0x00:                                /* fmul */
+    case 0x05:                                /* fadd */
+    case 0x06:                                /* fsub */
+    case 0x0e: return 1;                      /* fdiv */
+    case 0x04: return ( types & 0x14 ) == 0;  /* flt, from an integer */
+    case 0x09: return ( types & 0x11 ) == 0;  /* int, to an integer   */
+  }
+  return 0;
+}
+
+static inline double fp_get( const int *reg, unsigned int n, unsigned int t ){
+  union { unsigned long long u; double d; } dv;
+  union { unsigned int u; float f; } sv;
+
+  if( t ){
+    dv.u = ( (unsigned long long)(unsigned int)reg[ n ] << 32 )
+         | (unsigned int)reg[ ( n + 1 ) & 31 ];
+    return dv.d;
+  }
+  sv.u = reg[ n ];
+  return sv.f;
+}
+
+/* a single result is rounded once, from the exact double result of */
+/*   single operands; r0 must be cleared again afterwards            */
+
+static inline void fp_set( int *reg, unsigned int n, unsigned int t, double v ){
+  union { unsigned long long u; double d; } dv;
+  union { unsigned int u; float f; } sv;
+
+  if( t ){
+    dv.d = v;
+    reg[ n ] = dv.u >> 32;
+    reg[ ( n + 1 ) & 31 ] = (unsigned int)dv.u;
+  }else{
+    sv.f = (float)v;
+    reg[ n ] = sv.u;
+  }
+}
+
+/* int, rounded to nearest even as with the reset FPCR; a NaN or a */
+/*   value out of range is the integer conversion overflow trap,    */
+/*   and returns 0                                                 */
+
+static inline int fp_int( double v, int *result ){
+  double t, f;
+
+  if( !( ( v > -2147483649.0 ) && ( v < 2147483648.0 ) ) ) return 0;
+  t = (double)(long long)v;                   /* toward zero, exact */
+  f = v - t;
+  if( ( f > 0.5 ) || ( ( f == 0.5 ) && ( (long long)t & 1 ) ) ) t += 1.0;
+  if( ( f < -0.5 ) || ( ( f == -0.5 ) && ( (long long)t & 1 ) ) ) t -= 1.0;
+  if( ( t < -2147483648.0 ) || ( t > 2147483647.0 ) ) return 0;
+  *result = (int)t;
+  return 1;
+}
+
+/* threaded.c */
+
+void run_fast( struct sim88 *s );
+void run_lockstep( struct sim88 *s );
+void lockstep_free( struct sim88 *s );
+void engine_free( struct sim88 *s );
+struct warm_code *code_save( const struct sim88 *s, const unsigned int *words,
+                             unsigned int count );
+void code_seed( struct sim88 *s, const struct warm_code *w );
+void code_free( struct warm_code *w );
+void log_write( struct write_log *log, unsigned int address, unsigned int value );
+
+/* memory.c */
+
+void *map_zeroed( size_t size );
+void unmap( void *p, size_t size );
+int mem_alloc( struct sim88 *s );
+void mem_free( struct sim88 *s );
+int read_program( FILE *in, int binary, unsigned int **words,
+                  unsigned int *count );
+void read_mem( struct sim88 *s, int address, int reg_index );
+void write_mem( struct sim88 *s, int address, int reg_index );
+void bad_address( struct sim88 *s, unsigned int address ) __attribute__(( noreturn ));
+
+/* stats.c */
+
+double wall_seconds( struct sim88 *s );
+void ws_touch( struct sim88 *s, struct working_set *w, unsigned int address );
+void ws_free( struct working_set *w );
+void interval_init( struct sim88 *s );
+void interval_snapshot( struct sim88 *s );
+void interval_finish( struct sim88 *s );
+
+/* the main loop and the handlers call tsc_mark() at the boundaries */
+/*   between phases, and the host ticks since the previous mark are   */
+/*   charged to the phase that just ended                             */
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define TICK_SOURCE "rdtsc"
+static inline unsigned long long read_ticks( void ){ return __rdtsc(); }
+#else
+#define TICK_SOURCE "ns"
+static inline unsigned long long read_ticks( void ){
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+static inline void tsc_mark( struct sim88 *s, int phase ){
+  unsigned long long now = read_ticks();
+  s->host_ticks[ phase ] += now - s->last_tick;
+  s->last_tick = now;
+}
+
+/* cli.c */
+
+struct cli_options {
+  struct sim88_config config;
+  enum sim88_format format;
+  int binary_input;
+  const char **plugins;          /* argc entries */
+  int num_plugins;
+};
+
+int parse_option( int argc, char **argv, int *i, struct cli_options *o );
+int parse_job_options( int argc, char **words, struct cli_options *o );
+
+/* plugin.c */
+
+void plugin_fetch( struct sim88 *s );
+void plugin_decode( struct sim88 *s );
+void plugin_retire( struct sim88 *s, unsigned long long reads,
+                    unsigned long long writes, unsigned long long taken );
+void plugin_finish( struct sim88 *s, FILE *out );
+void plugin_enter( struct sim88 *s );
+
+#endif
@@ -0,0 +1,466 @@
+/* statistics: the text, json and csv reports, the execution profile,
+ *   the instruction mix, the self profile, and --interval output
+ *
+ * the json and csv reports record every statistic once as a section,
+ *   a name, and its formatted value, and the list is then written in
+ *   either format
+ */
+
+#define _GNU_SOURCE   /* qsort_r */
+#include <stdlib.h>
+#include <string.h>
+#include "sim88_internal.h"
+
+static const char *host_phase_names[NUM_HOST_PHASES] = {
+  "fetch_decode", "execute", "cache", "trace", "other"
+};
+
+double wall_seconds( struct sim88 *s ){
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return ( now.tv_sec - s->start_time.tv_sec )
+       + ( now.tv_nsec - s->start_time.tv_nsec ) * 1e-9;
+}
+
+
+/* working-set size for --interval: the distinct lines and pages    */
+/*   touched by instruction fetches and by data accesses during each  */
+/*   interval and over the whole run; the simulated memory is small   */
+/*   enough to count exactly with one epoch stamp per line and page   */
+
+#define WS_LINE_SHIFT 3     /* 8-byte lines, as in the data cache */
+#define WS_PAGE_SHIFT 12    /* 4 KiB pages                        */
+
+static void ws_alloc( struct sim88 *s, struct working_set *w ){
+  unsigned int lines = s->mem_size_in_words >> ( WS_LINE_SHIFT - 2 ),
+               pages = ( s->mem_size_in_words >> ( WS_PAGE_SHIFT - 2 ) ) + 1;
+
+  w->line_epoch = calloc( lines, sizeof( unsigned int ) );
+  w->page_epoch = calloc( pages, sizeof( unsigned int ) );
+  w->line_seen = calloc( lines, 1 );
+  w->page_seen = calloc( pages, 1 );
+  if( !( w->line_epoch && w->page_epoch && w->line_seen && w->page_seen ) ){
+    sim88_fail( s, "cannot allocate the working set of %d words\n",
+      s->mem_size_in_words );
+  }
+}
+
+void ws_free( struct working_set *w ){
+  free( w->line_epoch );
+  free( w->page_epoch );
+  free( w->line_seen );
+  free( w->page_seen );
+  memset( w, 0, sizeof( struct working_set ) );
+}
+
+void ws_touch( struct sim88 *s, struct working_set *w, unsigned int address ){
+  unsigned int line = address >> WS_LINE_SHIFT,
+               page = address >> WS_PAGE_SHIFT;
+
+  if( w->line_epoch[ line ] == s->ws_epoch ) return;
+  w->line_epoch[ line ] = s->ws_epoch;
+  w->lines++;
+  if( !w->line_seen[ line ] ){
+    w->line_seen[ line ] = 1;
+    w->total_lines++;
+  }
+
+  if( w->page_epoch[ page ] == s->ws_epoch ) return;
+  w->page_epoch[ page ] = s->ws_epoch;
+  w->pages++;
+  if( !w->page_seen[ page ] ){
+    w->page_seen[ page ] = 1;
+    w->total_pages++;
+  }
+}
+
+/* start the next interval */
+
+static void ws_next( struct sim88 *s ){
+  s->ws_inst.lines = s->ws_inst.pages = 0;
+  s->ws_data.lines = s->ws_data.pages = 0;
+  s->ws_epoch++;
+}
+
+
+/* interval statistics for --interval N                              */
+/*   every N retired instructions the change in each counter since   */
+/*   the previous snapshot and the working-set size of the interval   */
+/*   are appended as one csv row to the interval file, which is       */
+/*   written through a large stdio buffer                             */
+
+#define INTERVAL_BUFFER_SIZE ( 1 << 20 )
+
+void interval_init( struct sim88 *s ){
+  s->interval_file = fopen( s->config.interval_name, "w" );
+  if( s->interval_file == NULL ){
+    sim88_fail( s, "cannot open interval file %s\n", s->config.interval_name );
+  }
+  setvbuf( s->interval_file, NULL, _IOFBF, INTERVAL_BUFFER_SIZE );
+  s->track_working_set = 1;
+  ws_alloc( s, &s->ws_inst );
+  ws_alloc( s, &s->ws_data );
+  fprintf( s->interval_file, s->cache
+    ? "interval,end_fetch,fetches,reads,writes,branches,taken,hits,misses,write_backs,"
+      "inst_lines,inst_pages,data_lines,data_pages\n"
+    : "interval,end_fetch,fetches,reads,writes,branches,taken,"
+      "inst_lines,inst_pages,data_lines,data_pages\n" );
+  s->next_interval = s->config.interval_length;
+}
+
+void interval_snapshot( struct sim88 *s ){
+  struct cache none = { 0 },
+               *c = s->cache ? s->cache : &none;
+  struct snapshot now = { s->inst_fetches, s->memory_reads, s->memory_writes,
+                          s->branches, s->taken_branches,
+                          c->hits, c->misses, c->write_backs },
+                  *last = &s->last_snapshot;
+
+  fprintf( s->interval_file, "%llu,%llu,%llu,%llu,%llu,%llu,%llu,",
+    s->interval_count, s->inst_fetches,
+    now.fetches - last->fetches, now.reads - last->reads,
+    now.writes - last->writes, now.branches - last->branches,
+    now.taken - last->taken );
+  if( s->cache ){
+    fprintf( s->interval_file, "%llu,%llu,%llu,",
+      now.hits - last->hits, now.misses - last->misses,
+      now.write_backs - last->write_backs );
+  }
+  fprintf( s->interval_file, "%llu,%llu,%llu,%llu\n",
+    s->ws_inst.lines, s->ws_inst.pages, s->ws_data.lines, s->ws_data.pages );
+  *last = now;
+  ws_next( s );
+  s->interval_count++;
+  s->next_interval += s->config.interval_length;
+  if( s->self_profile ) tsc_mark( s, HOST_OTHER );
+}
+
+/* a final partial interval is written when the program halts */
+
+void interval_finish( struct sim88 *s ){
+  if( s->inst_fetches != s->last_snapshot.fetches ) interval_snapshot( s );
+  fclose( s->interval_file );
+  s->interval_file = NULL;
+}
+
+
+/* annotated disassembly of every executed instruction, hottest first */
+
+static int by_execs( const void *a, const void *b, void *arg ){
+  const struct pc_profile *profile = arg;
+  unsigned long long ea = profile[ *(const int *)a ].execs,
+                     eb = profile[ *(const int *)b ].execs;
+  if( ea != eb ) return ( ea < eb ) ? 1 : -1;
+  return *(const int *)a - *(const int *)b;
+}
+
+static void profile_report( struct sim88 *s ){
+  int *order = malloc( s->mem_size_in_words * sizeof( int ) ),
+      count = 0;
+  char buf[64];
+
+  if( order == NULL ){
+    fprintf( s->out, "cannot allocate the profile report\n" );
+    return;
+  }
+  for( int i = 0; i < s->mem_size_in_words; i++ ){
+    if( s->profile[ i ].execs ) order[ count++ ] = i;
+  }
+  qsort_r( order, count, sizeof( int ), by_execs, s->profile );
+
+  fprintf( s->out, "execution profile (in decimal, hottest first):\n" );
+  fprintf( s->out, s->cache
+    ? "  address    execs      %%      taken      reads     writes     misses"
+      "  instruction\n"
+    : "  address    execs      %%      taken      reads     writes"
+      "  instruction\n" );
+  for( int i = 0; i < count; i++ ){
+    struct pc_profile *p = &s->profile[ order[ i ] ];
+    s->ir = s->mem[ order[ i ] ];
+    decode( s );
+    disasm( s, buf );
+    fprintf( s->out, "  %7x %8llu %5.1f%% %10llu %10llu %10llu",
+      order[ i ] << 2, p->execs,
+      100.0*((float)p->execs)/((float)s->inst_fetches),
+      p->taken, p->reads, p->writes );
+    if( s->cache ) fprintf( s->out, " %10llu", p->misses );
+    fprintf( s->out, "  %s\n", buf );
+  }
+  free( order );
+}
+
+static void mix_report( struct sim88 *s ){
+  unsigned long long *op_counts = s->op_counts,
+                     alu, logical, muldiv, fp, shifts, loads, stores,
+                     imm_mode, reg_mode, scaled_mode;
+  FILE *out = s->out;
+
+  fprintf( out, "instruction mix (in decimal):\n" );
+  for( int i = 0; i < NUM_OPS; i++ ){
+    if( op_counts[ i ] == 0 ) continue;
+    fprintf( out, "  %-14s = %llu (%.1f%%)\n", op_names[ i ], op_counts[ i ],
+      100.0*((float)op_counts[ i ])/((float)s->inst_fetches) );
+  }
+
+  alu = op_counts[ OP_IMM_LDA ] + op_counts[ OP_IMM_ADD ]
+      + op_counts[ OP_IMM_SUB ] + op_counts[ OP_LDA ]
+      + op_counts[ OP_LDA_SCALED ] + op_counts[ OP_ADD ] + op_counts[ OP_SUB ]
+      + op_counts[ OP_IMM_CMP ] + op_counts[ OP_CMP ];
+  logical = 0;
+  for( int i = OP_IMM_AND; i <= OP_OR_C; i++ ) logical += op_counts[ i ];
+  muldiv = 0;
+  for( int i = OP_IMM_MUL; i <= OP_DIVU; i++ ) muldiv += op_counts[ i ];
+  fp = 0;
+  for( int i = OP_FADD; i <= OP_INT; i++ ) fp += op_counts[ i ];
+  shifts = op_counts[ OP_EXT ] + op_counts[ OP_EXTU ]
+         + op_counts[ OP_MAK ] + op_counts[ OP_ROT ];
+  loads = op_counts[ OP_IMM_LD ] + op_counts[ OP_LD ]
+        + op_counts[ OP_LD_SCALED ];
+  stores = op_counts[ OP_IMM_ST ] + op_counts[ OP_ST ]
+         + op_counts[ OP_ST_SCALED ];
+  fprintf( out, "instruction classes (in decimal):\n" );
+  fprintf( out, "  integer         = %llu\n", alu );
+  fprintf( out, "  logical         = %llu\n", logical );
+  fprintf( out, "  multiply/divide = %llu\n", muldiv );
+  fprintf( out, "  floating point  = %llu\n", fp );
+  fprintf( out, "  bit field       = %llu\n", shifts );
+  fprintf( out, "  load            = %llu\n", loads );
+  fprintf( out, "  store           = %llu\n", stores );
+  fprintf( out, "  branch          = %llu\n", op_counts[ OP_BR ] + op_counts[ OP_BCND ]
+    + op_counts[ OP_BSR ] + op_counts[ OP_JMP ] + op_counts[ OP_JSR ]
+    + op_counts[ OP_BB0 ] + op_counts[ OP_BB1 ] );
+  fprintf( out, "  halt            = %llu\n", op_counts[ OP_HALT ] );
+
+  /* addressing modes of ld, st, and lda, see pages 3-7 to 3-10 */
+  imm_mode = op_counts[ OP_IMM_LD ] + op_counts[ OP_IMM_ST ]
+           + op_counts[ OP_IMM_LDA ];
+  reg_mode = op_counts[ OP_LD ] + op_counts[ OP_ST ] + op_counts[ OP_LDA ];
+  scaled_mode = op_counts[ OP_LD_SCALED ] + op_counts[ OP_ST_SCALED ]
+              + op_counts[ OP_LDA_SCALED ];
+  fprintf( out, "addressing modes (in decimal):\n" );
+  fprintf( out, "  reg + imm16     = %llu\n", imm_mode );
+  fprintf( out, "  reg + reg       = %llu\n", reg_mode );
+  fprintf( out, "  reg + reg << 2  = %llu\n", scaled_mode );
+}
+
+/* the cache phase is left out of the self profile without a cache */
+
+static void self_profile_report( struct sim88 *s ){
+  double seconds = wall_seconds( s );
+  unsigned long long total = 0;
+
+  for( int i = 0; i < NUM_HOST_PHASES; i++ ) total += s->host_ticks[ i ];
+  if( total == 0 ) total = 1;
+
+  fprintf( s->out, "simulator self profile (host):\n" );
+  fprintf( s->out, "  wall time           = %.6f s\n", seconds );
+  fprintf( s->out, "  simulated MIPS      = %.3f\n",
+    ( seconds > 0.0 ) ? s->inst_fetches / seconds / 1e6 : 0.0 );
+  fprintf( s->out, "  ticks (%s) / inst = %.1f\n", TICK_SOURCE,
+    s->inst_fetches ? ((double)total) / s->inst_fetches : 0.0 );
+  for( int i = 0; i < NUM_HOST_PHASES; i++ ){
+    if( ( i == HOST_CACHE ) && !s->cache ) continue;
+    fprintf( s->out, "  %-19s = %.1f%%\n", host_phase_names[ i ],
+      100.0 * s->host_ticks[ i ] / total );
+  }
+}
+
+
+/* machine-readable statistics for --stats-format=json and csv */
+
+static struct stat_entry *stat_new( struct sim88 *s, const char *section,
+                                    const char *name ){
+  struct stat_entry *e = &s->stat_list[ s->num_stats ];
+  if( s->num_stats == MAX_STATS ){
+    fprintf( stderr, "too many statistics\n" );
+    abort();
+  }
+  s->num_stats++;
+  e->section = section;
+  e->name = name;
+  e->is_string = 0;
+  return e;
+}
+
+static void stat_count( struct sim88 *s, const char *section, const char *name,
+                        unsigned long long value ){
+  sprintf( stat_new( s, section, name )->value, "%llu", value );
+}
+
+static void stat_real( struct sim88 *s, const char *section, const char *name,
+                       double value ){
+  sprintf( stat_new( s, section, name )->value, "%.6f", value );
+}
+
+static void stat_string( struct sim88 *s, const char *section, const char *name,
+                         const char *value ){
+  struct stat_entry *e = stat_new( s, section, name );
+  snprintf( e->value, sizeof( e->value ), "%s", value );
+  e->is_string = 1;
+}
+
+/* final register values, so that benchmark checksums can be checked */
+
+static const char *reg_keys[32] = {
+  "r0",  "r1",  "r2",  "r3",  "r4",  "r5",  "r6",  "r7",
+  "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15",
+  "r16", "r17", "r18", "r19", "r20", "r21", "r22", "r23",
+  "r24", "r25", "r26", "r27", "r28", "r29", "r30", "r31"
+};
+
+static const char *engine_names[] = { "switch", "threaded" };
+
+static void record_stats( struct sim88 *s ){
+  double seconds = wall_seconds( s );
+  const struct sim88_config *c = &s->config;
+
+  s->num_stats = 0;
+  stat_string( s, "config", "simulator", s->cache ? "mc88100-cache" : "mc88100" );
+  stat_count( s, "config", "mem_size_words", s->mem_size_in_words );
+  stat_count( s, "config", "trace_level", s->verbose );
+  stat_count( s, "config", "profiling", c->profiling );
+  stat_count( s, "config", "interval", c->interval_length );
+  stat_count( s, "config", "self_profile", s->self_profile );
+  stat_string( s, "config", "engine", s->engine_used ? s->engine_used
+                                      : c->lockstep_every ? "lockstep"
+                                      : engine_names[ c->engine ] );
+  if( s->cache ){
+    stat_count( s, "config", "cache_sets", LINES_PER_BANK );
+    stat_count( s, "config", "cache_ways", 2 );
+    stat_count( s, "config", "cache_line_bytes", 8 );
+    stat_string( s, "config", "cache_write_policy", "write-back" );
+    stat_string( s, "config", "cache_replacement", "lru" );
+  }
+
+  stat_count( s, "core", "inst_fetches", s->inst_fetches );
+  stat_count( s, "core", "memory_reads", s->memory_reads );
+  stat_count( s, "core", "memory_writes", s->memory_writes );
+  stat_count( s, "core", "branches", s->branches );
+  stat_count( s, "core", "taken_branches", s->taken_branches );
+  if( c->inst_limit ){
+    stat_count( s, "core", "inst_limit", c->inst_limit );
+    stat_count( s, "core", "halted", s->halt_flag );
+  }
+
+  if( s->cache ){
+    stat_count( s, "cache", "reads", s->cache->reads );
+    stat_count( s, "cache", "writes", s->cache->writes );
+    stat_count( s, "cache", "hits", s->cache->hits );
+    stat_count( s, "cache", "misses", s->cache->misses );
+    stat_count( s, "cache", "write_backs", s->cache->write_backs );
+  }
+
+  for( int i = 0; i < NUM_OPS; i++ ){
+    stat_count( s, "mix", op_keys[ i ], s->op_counts[ i ] );
+  }
+
+  for( int i = 0; i < 32; i++ ){
+    stat_count( s, "registers", reg_keys[ i ], (unsigned int)s->reg[ i ] );
+  }
+
+  stat_real( s, "host", "wall_seconds", seconds );
+  stat_real( s, "host", "mips",
+    ( seconds > 0.0 ) ? s->inst_fetches / seconds / 1e6 : 0.0 );
+
+  if( s->track_working_set ){
+    stat_count( s, "working_set", "inst_lines", s->ws_inst.total_lines );
+    stat_count( s, "working_set", "inst_pages", s->ws_inst.total_pages );
+    stat_count( s, "working_set", "data_lines", s->ws_data.total_lines );
+    stat_count( s, "working_set", "data_pages", s->ws_data.total_pages );
+  }
+
+  if( s->self_profile ){
+    for( int i = 0; i < NUM_HOST_PHASES; i++ ){
+      if( ( i == HOST_CACHE ) && !s->cache ) continue;
+      stat_count( s, "self_profile", host_phase_names[ i ], s->host_ticks[ i ] );
+    }
+  }
+
+  if( c->lockstep_every ){
+    stat_count( s, "lockstep", "span", c->lockstep_every );
+    stat_count( s, "lockstep", "checks", s->lockstep_checks );
+  }
+}
+
+static void print_stats_json( struct sim88 *s ){
+  const char *section = NULL;
+  FILE *out = s->out;
+
+  fprintf( out, "{" );
+  for( int i = 0; i < s->num_stats; i++ ){
+    struct stat_entry *e = &s->stat_list[ i ];
+    if( ( section == NULL ) || strcmp( section, e->section ) ){
+      fprintf( out, "%s\n  \"%s\": {", section ? "\n  }," : "", e->section );
+      section = e->section;
+    }else{
+      fprintf( out, "," );
+    }
+    fprintf( out, e->is_string ? "\n    \"%s\": \"%s\"" : "\n    \"%s\": %s",
+      e->name, e->value );
+  }
+  fprintf( out, "\n  }" );
+
+  if( s->config.profiling ){
+    int first = 1;
+    fprintf( out, ",\n  \"profile\": [" );
+    for( int i = 0; i < s->mem_size_in_words; i++ ){
+      struct pc_profile *p = &s->profile[ i ];
+      if( p->execs == 0 ) continue;
+      fprintf( out, "%s\n    { \"pc\": %d, \"execs\": %llu, \"taken\": %llu,"
+                    " \"reads\": %llu, \"writes\": %llu",
+        first ? "" : ",", i << 2, p->execs, p->taken, p->reads, p->writes );
+      if( s->cache ) fprintf( out, ", \"misses\": %llu", p->misses );
+      fprintf( out, " }" );
+      first = 0;
+    }
+    fprintf( out, "\n  ]" );
+  }
+  fprintf( out, "\n}\n" );
+}
+
+/* csv is a header row of section.name columns and one row of values */
+/*   so that the output of many runs can be concatenated              */
+
+static void print_stats_csv( struct sim88 *s ){
+  for( int i = 0; i < s->num_stats; i++ ){
+    fprintf( s->out, "%s%s.%s", i ? "," : "", s->stat_list[ i ].section,
+      s->stat_list[ i ].name );
+  }
+  fprintf( s->out, "\n" );
+  for( int i = 0; i < s->num_stats; i++ ){
+    fprintf( s->out, "%s%s", i ? "," : "", s->stat_list[ i ].value );
+  }
+  fprintf( s->out, "\n" );
+}
+
+void sim88_report( struct sim88 *s, enum sim88_format format ){
+  FILE *out = s->out;
+
+  if( format != SIM88_STATS_TEXT ){
+    record_stats( s );
+    if( format == SIM88_STATS_JSON ) print_stats_json( s );
+    else print_stats_csv( s );
+    plugin_finish( s, stderr );   /* text reports, outside the document */
+    return;
+  }
+  fprintf( out, "execution statistics (in decimal):\n" );
+  fprintf( out, "  instruction fetches = %llu\n", s->inst_fetches );
+  fprintf( out, "  data words read     = %llu\n", s->memory_reads );
+  fprintf( out, "  data words written  = %llu\n", s->memory_writes );
+  fprintf( out, "  branches executed   = %llu\n", s->branches );
+  if( s->taken_branches == 0 ){
+    fprintf( out, "  branches taken      = 0\n" );
+  }else{
+    fprintf( out, "  branches taken      = %llu (%.1f%%)\n",
+      s->taken_branches, 100.0*((float)s->taken_branches)/((float)s->branches) );
+  }
+  if( !s->halt_flag ){
+    fprintf( out, "  stopped at the limit of %llu instructions, before the halt\n",
+      s->config.inst_limit );
+  }
+  if( s->cache ) cache_stats( s->cache, out );
+  if( s->config.show_mix ) mix_report( s );
+  if( s->config.profiling ) profile_report( s );
+  if( s->self_profile ) self_profile_report( s );
+  plugin_finish( s, out );
+}
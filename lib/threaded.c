@@ -0,0 +1,744 @@
+/* predecoded threaded engine for --engine threaded
+ *
+ * each memory word gets a predecoded entry the first time it is
+ *   executed, holding its handler number and register fields, and the
+ *   handlers dispatch straight to the next entry through a label table
+ *   (computed goto, a gcc and clang extension); a store clears the
+ *   entry of the word it writes, so that code written by the program
+ *   is decoded again
+ *
+ * the engine keeps its state in a struct machine so that --lockstep
+ *   can run it beside the switch engine; it implements only the
+ *   statistics and the data cache, so the switch engine is used
+ *   whenever a trace, the profile, intervals, the self profile, or a
+ *   plugin is requested
+ *
+ * the predecoded words of a run can be saved and seeded into a later
+ *   context that loads the same program, see code_save(), so that the
+ *   server does not decode a program again for every job
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sim88_internal.h"
+
+struct predecoded {
+  unsigned char op,      /* OP_* + 1, or 0 until the word is decoded */
+                d, s1, s2;
+  int imm;               /* imm16, the whole 32-bit operand of a      */
+                         /*   logical operation, a branch displacement */
+                         /*   in bytes, or the T1, T2, and TD sizes of */
+                         /*   a floating point operation in bits 5-0   */
+};
+
+struct machine {
+  int reg[32],
+      *mem,
+      halted;
+  unsigned int fip,
+               xip,
+               words;           /* memory size */
+  struct predecoded *code;      /* one entry per memory word, and one */
+                                /*   past the end that is never decoded */
+  unsigned long long inst_fetches, memory_reads, memory_writes,
+                     branches, taken_branches,
+                     op_counts[NUM_OPS];
+  struct cache *cache;          /* or NULL */
+  struct write_log *log;        /* or NULL */
+};
+
+#define CODE_SIZE( s ) ( ( (s)->mem_size_in_words + 1 ) * sizeof( struct predecoded ) )
+
+/* code is the predecoded code of an earlier run, or NULL */
+
+static void machine_init( struct sim88 *s, struct machine *m, int *memory,
+                          struct predecoded *code ){
+  memset( m, 0, sizeof( struct machine ) );
+  m->mem = memory;
+  m->words = s->mem_size_in_words;
+  m->code = code ? code : map_zeroed( CODE_SIZE( s ) );
+  if( m->code == NULL ){
+    sim88_fail( s, "cannot allocate %d predecoded words\n", s->mem_size_in_words );
+  }
+}
+
+void log_write( struct write_log *log, unsigned int address, unsigned int value ){
+  if( log->count == log->max ){
+    log->max = log->max ? 2 * log->max : 1024;
+    log->entries = realloc( log->entries, 2 * log->max * sizeof( unsigned int ) );
+    if( log->entries == NULL ){
+      fprintf( stderr, "cannot grow the lockstep store log\n" );
+      abort();
+    }
+  }
+  log->entries[ 2 * log->count ] = address;
+  log->entries[ 2 * log->count + 1 ] = value;
+  log->count++;
+}
+
+/* fill the entry of the word at pc, using the same decode() and the */
+/*   same checks as the switch engine                                */
+
+static void predecode( struct sim88 *s, struct machine *m, unsigned int pc ){
+  struct predecoded *p = &m->code[ pc >> 2 ];
+  int op = 0;
+
+  s->xip = pc;
+  s->ir = m->mem[ pc >> 2 ];
+  decode( s );
+  p->imm = s->imm16;
+
+  switch( s->op1 ){
+    case 0x00:        op = OP_HALT;                 break;
+    case 0x05:        op = OP_IMM_LD;               break;
+    case 0x09:        op = OP_IMM_ST;               break;
+    case 0x0d:        op = OP_IMM_LDA;              break;
+    case 0x1c:        op = OP_IMM_ADD;              break;
+    case 0x1d:        op = OP_IMM_SUB;              break;
+    case 0x1a:        op = OP_IMM_DIVU;             break;
+    case 0x1b:        op = OP_IMM_MUL;              break;
+    case 0x1e:        op = OP_IMM_DIV;              break;
+    case 0x1f:        op = OP_IMM_CMP;              break;
+    case 0x10:        op = OP_IMM_AND;              break;
+    case 0x11:        op = OP_IMM_AND_U;            break;
+    case 0x12:        op = OP_IMM_MASK;             break;
+    case 0x13:        op = OP_IMM_MASK_U;           break;
+    case 0x14:        op = OP_IMM_XOR;              break;
+    case 0x15:        op = OP_IMM_XOR_U;            break;
+    case 0x16:        op = OP_IMM_OR;               break;
+    case 0x17:        op = OP_IMM_OR_U;             break;
+    case 0x30:
+    case 0x31:{
+      int d26 = s->ir & 0x03ffffff;
+      if( d26 == 0 ){
+        sim88_fail( s, "branch at %x has a zero displacement\n"
+                       "program terminates\n", pc );
+      }
+      d26 = d26 << 6;
+      p->imm = ( d26 >> 6 ) << 2;
+      op = ( s->op1 == 0x30 ) ? OP_BR : OP_BSR;
+      break;
+    }
+    case 0x34:
+    case 0x36:
+    case 0x3a:{
+      int d16 = s->ir & 0x0000ffff;
+      if( d16 == 0 ){
+        sim88_fail( s, "branch at %x has a zero displacement\n"
+                       "program terminates\n", pc );
+      }
+      d16 = d16 << 16;
+      p->imm = ( d16 >> 16 ) << 2;
+      op = ( s->op1 == 0x3a ) ? OP_BCND : ( s->op1 == 0x34 ) ? OP_BB0 : OP_BB1;
+      break;
+    }
+    case 0x3c:
+      switch( s->op2 ){
+        case 0x24:    op = OP_EXT;                  break;
+        case 0x26:    op = OP_EXTU;                 break;
+        case 0x28:    op = OP_MAK;                  break;
+        case 0x2a:    op = OP_ROT;                  break;
+        default:      unknown_op( s );
+      }
+      break;
+    case 0x3d:
+      switch( s->op2 ){
+        case 0x05:    op = OP_LD + s->scaled;       break;
+        case 0x09:    op = OP_ST + s->scaled;       break;
+        case 0x0d:    op = OP_LDA + s->scaled;      break;
+        case 0x1c:    op = OP_ADD;                  break;
+        case 0x1d:    op = OP_SUB;                  break;
+        case 0x1a:    op = OP_DIVU;                 break;
+        case 0x1f:    op = OP_CMP;                  break;
+        case 0x30:    op = OP_JMP;                  break;
+        case 0x32:    op = OP_JSR;                  break;
+        case 0x1b:    op = OP_MUL;                  break;
+        case 0x1e:    op = OP_DIV;                  break;
+        case 0x10:    op = OP_AND;                  break;
+        case 0x11:    op = OP_AND_C;                break;
+        case 0x14:    op = OP_XOR;                  break;
+        case 0x15:    op = OP_XOR_C;                break;
+        case 0x16:    op = OP_OR;                   break;
+        case 0x17:    op = OP_OR_C;                 break;
+        default:      unknown_op( s );
+      }
+      break;
+    case 0x21:
+      if( !fp_valid( s->ir ) ) unknown_op( s );
+      switch( ( s->ir >> 11 ) & 0x1f ){
+        case 0x05:    op = OP_FADD;                 break;
+        case 0x06:    op = OP_FSUB;                 break;
+        case 0x00:    op = OP_FMUL;                 break;
+        case 0x0e:    op = OP_FDIV;                 break;
+        case 0x04:    op = OP_FLT;                  break;
+        case 0x09:    op = OP_INT;                  break;
+      }
+      p->imm = ( s->ir >> 5 ) & 0x3f;
+      break;
+    default:          unknown_op( s );
+  }
+
+  /* a zero immediate divisor traps whenever the word is executed */
+  if( ( ( op == OP_IMM_DIV ) || ( op == OP_IMM_DIVU ) ) && ( s->imm16 == 0 ) ){
+    divide_by_zero( s );
+  }
+
+  /* the immediate of a logical operation becomes its whole operand */
+  switch( op ){
+    case OP_IMM_AND:    p->imm = 0xffff0000u | s->imm16;                   break;
+    case OP_IMM_AND_U:  p->imm = ( (unsigned int)s->imm16 << 16 ) | 0xffff; break;
+    case OP_IMM_MASK_U:
+    case OP_IMM_XOR_U:
+    case OP_IMM_OR_U:   p->imm = (unsigned int)s->imm16 << 16;             break;
+  }
+
+  p->d = s->d;
+  p->s1 = s->s1;
+  p->s2 = s->s2;
+  p->op = op + 1;
+}
+
+/* run until halt, or until the first branch or halt at which the */
+/*   instruction count has reached limit; a branch target outside   */
+/*   the memory, or running off its end into the entry past it,     */
+/*   is a program error                                             */
+
+static void run_threaded( struct sim88 *s, struct machine *m,
+                          unsigned long long limit ){
+  static void *dispatch[ NUM_OPS + 1 ] = {
+    &&do_decode,
+    &&do_halt,
+    &&do_imm_ld, &&do_imm_st, &&do_imm_lda, &&do_imm_add, &&do_imm_sub,
+    &&do_br, &&do_bcnd,
+    &&do_ext, &&do_extu, &&do_mak, &&do_rot,
+    &&do_ld, &&do_ld_scaled, &&do_st, &&do_st_scaled,
+    &&do_lda, &&do_lda_scaled,
+    &&do_add, &&do_sub,
+    &&do_imm_and, &&do_imm_and_u, &&do_imm_mask, &&do_imm_mask_u,
+    &&do_imm_xor, &&do_imm_xor_u, &&do_imm_or, &&do_imm_or_u,
+    &&do_and, &&do_and_c, &&do_xor, &&do_xor_c, &&do_or, &&do_or_c,
+    &&do_imm_mul, &&do_imm_div, &&do_imm_divu, &&do_mul, &&do_div, &&do_divu,
+    &&do_bsr, &&do_jmp, &&do_jsr,
+    &&do_imm_cmp, &&do_cmp, &&do_bb0, &&do_bb1,
+    &&do_fadd, &&do_fsub, &&do_fmul, &&do_fdiv, &&do_flt, &&do_int
+  };
+  int *r = m->reg,
+      *memory = m->mem;
+  struct predecoded *code = m->code,
+                    *p;
+  unsigned long long count = m->inst_fetches,
+                     *ops = m->op_counts;
+  unsigned int pc = m->fip,
+               words = m->words,
+               bad;           /* data address outside the memory */
+
+#define DISPATCH()  do{ p = &code[ pc >> 2 ]; goto *dispatch[ p->op ]; }while( 0 )
+#define START()     do{ count++; ops[ p->op - 1 ]++; }while( 0 )
+#define SET( v )    do{ r[ p->d ] = ( v ); r[ 0 ] = 0; pc += 4; DISPATCH(); }while( 0 )
+#define BLOCK_END() do{                                                 \
+    if( count >= limit ) goto out;                                      \
+    if( ( pc >> 2 ) >= words ) goto outside;                            \
+    DISPATCH();                                                         \
+  }while( 0 )
+#define DIVISOR( v ) do{ if( ( v ) == 0 ) goto divide_error; }while( 0 )
+#define FP1()       fp_get( r, p->s1, p->imm >> 4 )
+#define FP2()       fp_get( r, p->s2, ( p->imm >> 2 ) & 3 )
+#define FP_SET( v ) do{                                                 \
+    fp_set( r, p->d, p->imm & 3, ( v ) );                               \
+    r[ 0 ] = 0;                                                         \
+    pc += 4;                                                            \
+    DISPATCH();                                                         \
+  }while( 0 )
+#define LOAD( address ) do{                                             \
+    unsigned int a = ( address );                                       \
+    if( ( a >> 2 ) >= words ){ bad = a; goto bad_data; }                \
+    m->memory_reads++;                                                  \
+    if( m->cache ) cache_access( m->cache, a, 0 );                      \
+    SET( memory[ a >> 2 ] );                                            \
+  }while( 0 )
+#define STORE( address ) do{                                            \
+    unsigned int a = ( address );                                       \
+    if( ( a >> 2 ) >= words ){ bad = a; goto bad_data; }                \
+    memory[ a >> 2 ] = r[ p->d ];                                       \
+    code[ a >> 2 ].op = 0;                                              \
+    m->memory_writes++;                                                 \
+    if( m->cache ) cache_access( m->cache, a, 1 );                      \
+    if( m->log ) log_write( m->log, a, memory[ a >> 2 ] );              \
+    pc += 4;                                                            \
+    DISPATCH();                                                         \
+  }while( 0 )
+
+  if( ( pc >> 2 ) >= words ) goto outside;
+  DISPATCH();
+
+do_decode:
+  if( ( pc >> 2 ) >= words ) goto outside;    /* ran off the end */
+  predecode( s, m, pc );
+  DISPATCH();
+
+do_halt:       START(); m->halted = 1; pc += 4; goto out;
+do_imm_ld:     START(); LOAD( r[ p->s1 ] + p->imm );
+do_imm_st:     START(); STORE( r[ p->s1 ] + p->imm );
+do_imm_lda:    START(); SET( r[ p->s1 ] + p->imm );
+do_imm_add:    START(); SET( r[ p->s1 ] + p->imm );
+do_imm_sub:    START(); SET( r[ p->s1 ] - p->imm );
+do_ext:        START(); SET( r[ p->s1 ] >> p->s2 );
+do_extu:       START(); SET( (unsigned int)r[ p->s1 ] >> p->s2 );
+do_mak:        START(); SET( r[ p->s1 ] << p->s2 );
+do_rot:        START(); SET( ( (unsigned int)r[ p->s1 ] << ( ( 32 - p->s2 ) & 31 ) )
+                             | ( (unsigned int)r[ p->s1 ] >> p->s2 ) );
+do_ld:         START(); LOAD( r[ p->s1 ] + r[ p->s2 ] );
+do_ld_scaled:  START(); LOAD( r[ p->s1 ] + ( r[ p->s2 ] << 2 ) );
+do_st:         START(); STORE( r[ p->s1 ] + r[ p->s2 ] );
+do_st_scaled:  START(); STORE( r[ p->s1 ] + ( r[ p->s2 ] << 2 ) );
+do_lda:        START(); SET( r[ p->s1 ] + r[ p->s2 ] );
+do_lda_scaled: START(); SET( r[ p->s1 ] + ( r[ p->s2 ] << 2 ) );
+do_add:        START(); SET( r[ p->s1 ] + r[ p->s2 ] );
+do_sub:        START(); SET( r[ p->s1 ] - r[ p->s2 ] );
+
+/* predecode() made the immediate the whole operand */
+do_imm_and:
+do_imm_and_u:
+do_imm_mask:
+do_imm_mask_u: START(); SET( r[ p->s1 ] & p->imm );
+do_imm_xor:
+do_imm_xor_u:  START(); SET( r[ p->s1 ] ^ p->imm );
+do_imm_or:
+do_imm_or_u:   START(); SET( r[ p->s1 ] | p->imm );
+do_and:        START(); SET( r[ p->s1 ] & r[ p->s2 ] );
+do_and_c:      START(); SET( r[ p->s1 ] & ~r[ p->s2 ] );
+do_xor:        START(); SET( r[ p->s1 ] ^ r[ p->s2 ] );
+do_xor_c:      START(); SET( r[ p->s1 ] ^ ~r[ p->s2 ] );
+do_or:         START(); SET( r[ p->s1 ] | r[ p->s2 ] );
+do_or_c:       START(); SET( r[ p->s1 ] | ~r[ p->s2 ] );
+
+/* predecode() has already trapped a zero immediate divisor */
+do_imm_mul:    START(); SET( (unsigned int)r[ p->s1 ] * p->imm );
+do_imm_div:    START(); SET( r[ p->s1 ] / p->imm );
+do_imm_divu:   START(); SET( (unsigned int)r[ p->s1 ] / p->imm );
+do_mul:        START(); SET( (unsigned int)r[ p->s1 ] * (unsigned int)r[ p->s2 ] );
+do_div:        START(); DIVISOR( r[ p->s2 ] ); SET( quotient( r[ p->s1 ], r[ p->s2 ] ) );
+do_divu:       START(); DIVISOR( r[ p->s2 ] );
+               SET( (unsigned int)r[ p->s1 ] / (unsigned int)r[ p->s2 ] );
+do_imm_cmp:    START(); SET( compare( r[ p->s1 ], p->imm ) );
+do_cmp:        START(); SET( compare( r[ p->s1 ], r[ p->s2 ] ) );
+
+/* predecode() left the operand sizes in imm */
+do_fadd:       START(); FP_SET( FP1() + FP2() );
+do_fsub:       START(); FP_SET( FP1() - FP2() );
+do_fmul:       START(); FP_SET( FP1() * FP2() );
+do_fdiv:       START(); FP_SET( FP1() / FP2() );
+do_flt:        START(); FP_SET( r[ p->s2 ] );
+do_int:{
+  int result;
+
+  START();
+  if( !fp_int( FP2(), &result ) ) goto conversion_error;
+  SET( result );
+}
+
+do_br:
+  START();
+  m->branches++;
+  m->taken_branches++;
+  pc += p->imm;
+  BLOCK_END();
+
+do_bsr:
+  START();
+  m->branches++;
+  m->taken_branches++;
+  r[ 1 ] = pc + 4;
+  pc += p->imm;
+  BLOCK_END();
+
+/* an indirect target needs no lookup of its own: every word has its */
+/*   entry in code[], decoded or not, so a return dispatches as fast  */
+/*   as any other branch                                              */
+
+do_jmp:
+  START();
+  m->branches++;
+  m->taken_branches++;
+  pc = r[ p->s2 ] & ~3u;
+  BLOCK_END();
+
+do_jsr:{
+  unsigned int link = pc + 4;   /* set after rS2 is read, for jsr r1 */
+
+  START();
+  m->branches++;
+  m->taken_branches++;
+  pc = r[ p->s2 ] & ~3u;
+  r[ 1 ] = link;
+  BLOCK_END();
+}
+
+do_bcnd:{
+  unsigned int v = r[ p->s1 ];
+  int flag = ( ( v >> 31 ) << 1 ) | ( ( v << 1 ) == 0 );
+
+  START();
+  m->branches++;
+  if( ( p->d >> flag ) & 1 ){
+    pc += p->imm;
+    m->taken_branches++;
+  }else{
+    pc += 4;
+  }
+  BLOCK_END();
+}
+
+do_bb0:
+do_bb1:
+  START();
+  m->branches++;
+  if( ( ( (unsigned int)r[ p->s1 ] >> p->d ) & 1 ) == ( p->op - 1 == OP_BB1 ) ){
+    pc += p->imm;
+    m->taken_branches++;
+  }else{
+    pc += 4;
+  }
+  BLOCK_END();
+
+bad_data:
+  m->inst_fetches = count;
+  s->xip = ( p - code ) << 2;
+  bad_address( s, bad );
+
+divide_error:
+  m->inst_fetches = count;
+  s->xip = ( p - code ) << 2;
+  divide_by_zero( s );
+
+conversion_error:
+  m->inst_fetches = count;
+  s->xip = ( p - code ) << 2;
+  conversion_overflow( s );
+
+outside:
+  m->inst_fetches = count;
+  s->xip = pc;
+  bad_address( s, pc );
+
+out:
+  m->xip = ( p - code ) << 2;
+  m->fip = pc;
+  m->inst_fetches = count;
+
+#undef DISPATCH
+#undef START
+#undef SET
+#undef BLOCK_END
+#undef DIVISOR
+#undef FP1
+#undef FP2
+#undef FP_SET
+#undef LOAD
+#undef STORE
+}
+
+/* start a machine from where the context stands */
+
+static void machine_load( struct sim88 *s, struct machine *m ){
+  m->fip = s->fip;
+  memcpy( m->reg, s->reg, sizeof( s->reg ) );
+  m->inst_fetches = s->inst_fetches;
+  m->memory_reads = s->memory_reads;
+  m->memory_writes = s->memory_writes;
+  m->branches = s->branches;
+  m->taken_branches = s->taken_branches;
+  memcpy( m->op_counts, s->op_counts, sizeof( s->op_counts ) );
+}
+
+/* run the program on the threaded engine from where the context */
+/*   stands, to the halt, and leave the results where the switch   */
+/*   engine would have left them                                   */
+
+void run_fast( struct sim88 *s ){
+  struct machine m;
+
+  if( s->halt_flag ) return;
+  machine_init( s, &m, s->mem, s->fast_code );
+  s->fast_code = m.code;
+  m.cache = s->cache;
+  machine_load( s, &m );
+  run_threaded( s, &m, ~0ULL );
+
+  memcpy( s->reg, m.reg, sizeof( s->reg ) );
+  s->fip = m.fip;
+  s->xip = m.xip;
+  s->halt_flag = m.halted;
+  s->inst_fetches = m.inst_fetches;
+  s->memory_reads = m.memory_reads;
+  s->memory_writes = m.memory_writes;
+  s->branches = m.branches;
+  s->taken_branches = m.taken_branches;
+  memcpy( s->op_counts, m.op_counts, sizeof( s->op_counts ) );
+}
+
+
+/* the predecoded words of a program, after a run of it on the     */
+/*   threaded engine; a word is kept only if the memory still holds */
+/*   what the program loaded there, since a store clears the entry   */
+/*   of the word it writes but the entry of a word written before it */
+/*   was first executed holds the written word                       */
+
+struct warm_code {
+  int mem_size_in_words;
+  unsigned int count,
+               max,
+               *index;
+  struct predecoded *entries;
+};
+
+struct warm_code *code_save( const struct sim88 *s, const unsigned int *words,
+                             unsigned int count ){
+  const struct predecoded *code = s->fast_code;
+  struct warm_code *w;
+
+  if( code == NULL ) return NULL;
+  w = calloc( 1, sizeof( struct warm_code ) );
+  if( w == NULL ) return NULL;
+  w->mem_size_in_words = s->mem_size_in_words;
+  for( unsigned int i = 0; i < (unsigned int)s->mem_size_in_words; i++ ){
+    unsigned int loaded = ( i < count ) ? words[ i ] : 0;
+
+    if( ( code[ i ].op == 0 ) || ( (unsigned int)s->mem[ i ] != loaded ) ) continue;
+    if( w->count == w->max ){
+      unsigned int *index;
+      struct predecoded *entries;
+
+      w->max = w->max ? 2 * w->max : 256;
+      index = realloc( w->index, w->max * sizeof( unsigned int ) );
+      if( index ) w->index = index;
+      entries = realloc( w->entries, w->max * sizeof( struct predecoded ) );
+      if( entries ) w->entries = entries;
+      if( ( index == NULL ) || ( entries == NULL ) ){
+        code_free( w );
+        return NULL;
+      }
+    }
+    w->index[ w->count ] = i;
+    w->entries[ w->count++ ] = code[ i ];
+  }
+  return w;
+}
+
+/* give a context that has just loaded the program the saved words */
+/*   as its predecoded code; nothing if the memory size differs     */
+
+void code_seed( struct sim88 *s, const struct warm_code *w ){
+  struct predecoded *code;
+
+  if( ( w == NULL ) || s->fast_code || ( s->config.engine != SIM88_ENGINE_THREADED )
+      || ( w->mem_size_in_words != s->mem_size_in_words ) ) return;
+  code = map_zeroed( CODE_SIZE( s ) );
+  if( code == NULL ) return;      /* run_fast() reports it */
+  for( unsigned int i = 0; i < w->count; i++ ) code[ w->index[ i ] ] = w->entries[ i ];
+  s->fast_code = code;
+}
+
+void code_free( struct warm_code *w ){
+  if( w == NULL ) return;
+  free( w->index );
+  free( w->entries );
+  free( w );
+}
+
+
+/* lockstep differential execution for --lockstep[=N]               */
+/*   the threaded engine runs on its own copy of memory and of the    */
+/*   cache to the first branch or halt at least N instructions past   */
+/*   the last check; the switch engine, which is the reference, then  */
+/*   runs to the same instruction count, and the two must agree on    */
+/*   the registers, fip, halting, the statistics, and every store of  */
+/*   the span in order; N = 1, the default, checks every block, and   */
+/*   the first divergence is reported with the instructions before it */
+
+static void lockstep_fetch( void *ctx, unsigned int pc, unsigned int inst ){
+  struct sim88 *s = ctx;
+  (void)inst;
+  s->lockstep_pcs[ s->lockstep_fetched++ % LOCKSTEP_HISTORY ] = pc;
+}
+
+static void lockstep_mem( void *ctx, unsigned int pc, unsigned int address,
+                          int is_write, unsigned int value ){
+  struct sim88 *s = ctx;
+  (void)pc;
+  if( is_write ) log_write( &s->lockstep_writes, address, value );
+}
+
+static int lockstep_count( struct sim88 *s, const char *name,
+                           unsigned long long ref, unsigned long long fast ){
+  if( ref == fast ) return 0;
+  fprintf( s->out, "  %-15s switch %llu, threaded %llu\n", name, ref, fast );
+  return 1;
+}
+
+static int lockstep_word( struct sim88 *s, const char *name,
+                          unsigned int ref, unsigned int fast ){
+  if( ref == fast ) return 0;
+  fprintf( s->out, "  %-15s switch %08x, threaded %08x\n", name, ref, fast );
+  return 1;
+}
+
+static void lockstep_compare( struct sim88 *s, struct machine *m,
+                              unsigned long long from ){
+  struct write_log *ref = &s->lockstep_writes,
+                   *fast = m->log;
+  struct cache none = { 0 },
+               *c = s->cache ? s->cache : &none,
+               *fc = m->cache ? m->cache : &none;
+  unsigned long long first;
+  int diverged = 0;
+  char buf[64];
+
+  for( int i = 0; i < 32; i++ ){
+    if( s->reg[ i ] != m->reg[ i ] ){
+      sprintf( buf, "r%d", i );
+      if( !diverged ){
+        fprintf( s->out, "lockstep divergence in instructions %llu to %llu:\n",
+          from + 1, s->inst_fetches );
+      }
+      diverged = 1;
+      lockstep_word( s, buf, s->reg[ i ], m->reg[ i ] );
+    }
+  }
+
+  /* print the header before the first difference of any other kind */
+#define CHECK( test ) do{                                               \
+    if( !diverged && ( test ) ){                                        \
+      fprintf( s->out, "lockstep divergence in instructions %llu to %llu:\n", \
+        from + 1, s->inst_fetches );                                    \
+      diverged = 1;                                                     \
+    }                                                                   \
+  }while( 0 )
+
+  CHECK( ( (unsigned int)s->fip != m->fip ) || ( s->halt_flag != m->halted )
+         || ( s->inst_fetches != m->inst_fetches )
+         || ( s->memory_reads != m->memory_reads )
+         || ( s->memory_writes != m->memory_writes )
+         || ( s->branches != m->branches )
+         || ( s->taken_branches != m->taken_branches )
+         || memcmp( s->op_counts, m->op_counts, sizeof( s->op_counts ) )
+         || ( c->reads != fc->reads ) || ( c->writes != fc->writes )
+         || ( c->hits != fc->hits ) || ( c->misses != fc->misses )
+         || ( c->write_backs != fc->write_backs )
+         || ( ref->count != fast->count )
+         || memcmp( ref->entries, fast->entries,
+                    2 * ref->count * sizeof( unsigned int ) ) );
+#undef CHECK
+
+  if( !diverged ) return;
+
+  lockstep_word( s, "fip", s->fip, m->fip );
+  lockstep_count( s, "halted", s->halt_flag, m->halted );
+  lockstep_count( s, "inst_fetches", s->inst_fetches, m->inst_fetches );
+  lockstep_count( s, "memory_reads", s->memory_reads, m->memory_reads );
+  lockstep_count( s, "memory_writes", s->memory_writes, m->memory_writes );
+  lockstep_count( s, "branches", s->branches, m->branches );
+  lockstep_count( s, "taken_branches", s->taken_branches, m->taken_branches );
+  for( int i = 0; i < NUM_OPS; i++ ){
+    lockstep_count( s, op_keys[ i ], s->op_counts[ i ], m->op_counts[ i ] );
+  }
+  lockstep_count( s, "cache_reads", c->reads, fc->reads );
+  lockstep_count( s, "cache_writes", c->writes, fc->writes );
+  lockstep_count( s, "cache_hits", c->hits, fc->hits );
+  lockstep_count( s, "cache_misses", c->misses, fc->misses );
+  lockstep_count( s, "write_backs", c->write_backs, fc->write_backs );
+  lockstep_count( s, "stores in span", ref->count, fast->count );
+  for( unsigned int i = 0; ( i < ref->count ) && ( i < fast->count ); i++ ){
+    unsigned int *a = &ref->entries[ 2 * i ],
+                 *b = &fast->entries[ 2 * i ];
+    if( ( a[0] != b[0] ) || ( a[1] != b[1] ) ){
+      fprintf( s->out, "  store %-9u switch %08x to %x, threaded %08x to %x\n",
+        i + 1, a[1], a[0], b[1], b[0] );
+      break;
+    }
+  }
+
+  fprintf( s->out, "latest instructions of the switch engine:\n" );
+  first = ( s->lockstep_fetched > LOCKSTEP_HISTORY )
+        ? s->lockstep_fetched - LOCKSTEP_HISTORY : 0;
+  for( unsigned long long i = first; i < s->lockstep_fetched; i++ ){
+    unsigned int pc = s->lockstep_pcs[ i % LOCKSTEP_HISTORY ];
+    s->ir = s->mem[ pc >> 2 ];
+    decode( s );
+    disasm( s, buf );
+    fprintf( s->out, "  %llu at %02x, %s\n", i + 1, pc, buf );
+  }
+  sim88_fail( s, "%s", "" );
+}
+
+/* the shadow's memory, code, log, and cache live in a struct that */
+/*   engine_free() releases, so that a program error in either       */
+/*   engine does not leak them                                       */
+
+struct lockstep_shadow {
+  struct machine m;
+  struct write_log writes;
+  struct cache cache;
+  int *copy;
+};
+
+void run_lockstep( struct sim88 *s ){
+  struct lockstep_shadow *sh = calloc( 1, sizeof( struct lockstep_shadow ) );
+  struct sim_callbacks cb = { s, lockstep_fetch, NULL, lockstep_mem,
+                              NULL, NULL, NULL };
+  unsigned long long from;
+
+  if( sh ) sh->copy = malloc( s->mem_size_in_words * sizeof( int ) );
+  if( ( sh == NULL ) || ( sh->copy == NULL ) ){
+    if( sh ) free( sh );
+    sim88_fail( s, "cannot allocate %d words of memory\n", s->mem_size_in_words );
+  }
+  if( sim88_add_callbacks( s, &cb ) != 0 ){
+    free( sh->copy );
+    free( sh );
+    sim88_fail( s, "too many plugins for --lockstep\n" );
+  }
+  memcpy( sh->copy, s->mem, s->mem_size_in_words * sizeof( int ) );
+  s->lockstep_shadow = sh;
+  machine_init( s, &sh->m, sh->copy, NULL );
+  machine_load( s, &sh->m );
+  sh->m.log = &sh->writes;
+  if( s->cache ){
+    sh->cache = *s->cache;       /* both start from the same cache */
+    sh->m.cache = &sh->cache;
+  }
+
+  while( !s->halt_flag ){
+    from = s->inst_fetches;
+    sh->writes.count = s->lockstep_writes.count = 0;
+    run_threaded( s, &sh->m, from + s->config.lockstep_every );
+    s->run_limit = sh->m.inst_fetches;
+    run_hooked( s );
+    s->lockstep_checks++;
+    lockstep_compare( s, &sh->m, from );
+  }
+  s->run_limit = ~0ULL;
+}
+
+/* release the lockstep state after a run, and with engine_free() */
+/*   the predecoded code as well                                  */
+
+void lockstep_free( struct sim88 *s ){
+  struct lockstep_shadow *sh = s->lockstep_shadow;
+
+  if( sh == NULL ) return;
+  free( sh->writes.entries );
+  unmap( sh->m.code, CODE_SIZE( s ) );
+  free( sh->copy );
+  free( sh );
+  s->lockstep_shadow = NULL;
+  free( s->lockstep_writes.entries );
+  s->lockstep_writes.entries = NULL;
+  s->lockstep_writes.count = s->lockstep_writes.max = 0;
+}
+
+void engine_free( struct sim88 *s ){
+  unmap( s->fast_code, CODE_SIZE( s ) );
+  s->fast_code = NULL;
+  lockstep_free( s );
+}
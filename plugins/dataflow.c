@@ -0,0 +1,259 @@
+/* dataflow critical-path and ILP limit plugin for the MC88100 simulators
+ *
+ * models an ideal dataflow machine: unlimited issue width, perfect
+ *   branch prediction, and no resource conflicts, so an instruction
+ *   completes as soon as its operands are available plus its latency
+ *
+ *   ready( inst ) = max( ready of each source ) + latency( inst )
+ *
+ * sources are the registers an instruction reads (r0 is always ready),
+ *   both registers of a double operand, and, for ld, the memory word
+ *   it reads; st makes its memory word ready at its completion time;
+ *   branches read their register but nothing waits on them
+ *
+ * the critical path is the latest completion time of any instruction,
+ *   and the available ILP is the instruction count divided by it; with
+ *   interval=N the same is reported for every N instructions, using
+ *   the growth of the critical path during the interval
+ *
+ * usage
+ *
+ *   cc -O2 -shared -fPIC -o dataflow.so dataflow.c
+ *   sim --plugin ./dataflow.so[:name=value,...]
+ *
+ *   names are the latencies alu (add, sub, lda, and the logical
+ *   operations), shift (ext, extu, mak, rot), mul, div (div, divu), ld,
+ *   st, br, fadd (fadd, fsub, flt, int), fmul, and fdiv, in cycles, and
+ *   interval; mul and div default to the MC88100's 4 and 38 cycles, and
+ *   fadd, fmul, and fdiv to 5, 6, and 30
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_plugin.h"
+
+enum { LAT_ALU, LAT_SHIFT, LAT_MUL, LAT_DIV, LAT_LD, LAT_ST, LAT_BR,
+       LAT_FADD, LAT_FMUL, LAT_FDIV, NUM_LATENCIES };
+
+static const char *latency_names[NUM_LATENCIES] = {
+  "alu", "shift", "mul", "div", "ld", "st", "br", "fadd", "fmul", "fdiv"
+};
+
+static unsigned long long latency[NUM_LATENCIES] = {
+  1, 1, 4, 38, 3, 1, 1, 5, 6, 30
+};
+
+static unsigned long long reg_ready[32],
+                          *mem_ready,       /* by word address */
+                          mem_words,
+                          critical_path,    /* latest completion so far */
+                          instructions,
+                          pending_ready,    /* operands of this instruction */
+                          pending_done,     /* its completion time          */
+                          interval_length,
+                          interval_start_path;
+
+static int pending_class;
+
+struct interval {
+  unsigned long long instructions, path;
+};
+
+static struct interval *intervals;
+static unsigned int num_intervals,
+                    max_intervals;
+
+static unsigned long long max( unsigned long long a, unsigned long long b ){
+  return ( a > b ) ? a : b;
+}
+
+/* register n, and n + 1 as well for a double (t = 1) */
+
+static unsigned long long operand_ready( unsigned int n, unsigned int t ){
+  return t ? max( reg_ready[ n ], reg_ready[ ( n + 1 ) & 31 ] ) : reg_ready[ n ];
+}
+
+static unsigned long long *mem_slot( unsigned int address ){
+  unsigned long long word = address >> 2;
+
+  if( word >= mem_words ){
+    unsigned long long size = mem_words ? mem_words : 1024;
+    while( size <= word ) size *= 2;
+    mem_ready = realloc( mem_ready, size * sizeof( unsigned long long ) );
+    memset( mem_ready + mem_words, 0,
+      ( size - mem_words ) * sizeof( unsigned long long ) );
+    mem_words = size;
+  }
+  return &mem_ready[ word ];
+}
+
+static void complete( unsigned long long done ){
+  pending_done = done;
+  critical_path = max( critical_path, done );
+}
+
+static void end_interval(){
+  if( num_intervals == max_intervals ){
+    max_intervals = max_intervals ? 2 * max_intervals : 64;
+    intervals = realloc( intervals, max_intervals * sizeof( struct interval ) );
+  }
+  intervals[ num_intervals ].instructions = instructions;
+  intervals[ num_intervals ].path = critical_path - interval_start_path;
+  num_intervals++;
+  interval_start_path = critical_path;
+}
+
+static void on_decode( void *ctx, unsigned int pc, const struct sim_decoded *inst ){
+  int reg_form = ( inst->op1 == 0x3d );
+  unsigned int op = reg_form ? inst->op2 : inst->op1;
+
+  (void)ctx;
+  (void)pc;
+
+  if( interval_length && instructions && ( instructions % interval_length == 0 ) ){
+    end_interval();
+  }
+  instructions++;
+
+  pending_ready = reg_ready[ inst->s1 ];
+  if( reg_form ) pending_ready = max( pending_ready, reg_ready[ inst->s2 ] );
+
+  switch( inst->op1 ){
+    case 0x00: pending_class = -1;                       break;  /* halt */
+    case 0x30:                                                   /* br, bsr */
+    case 0x31: pending_class = LAT_BR; pending_ready = 0; break;
+    case 0x34:                                                   /* bb0, bb1 */
+    case 0x36:
+    case 0x3a: pending_class = LAT_BR;                   break;
+    case 0x3c: pending_class = LAT_SHIFT;                break;
+    case 0x21:{                                                  /* floating point */
+      unsigned int fop = ( inst->ir >> 11 ) & 0x1f;
+      pending_ready = operand_ready( inst->s2, ( inst->ir >> 7 ) & 3 );
+      if( ( fop != 0x04 ) && ( fop != 0x09 ) ){                  /* not flt, int */
+        pending_ready = max( pending_ready, operand_ready( inst->s1, ( inst->ir >> 9 ) & 3 ) );
+      }
+      pending_class = ( fop == 0x00 ) ? LAT_FMUL : ( fop == 0x0e ) ? LAT_FDIV : LAT_FADD;
+      break;
+    }
+    default:
+      if( op == 0x05 ){
+        pending_class = LAT_LD;
+      }else if( op == 0x09 ){
+        pending_class = LAT_ST;
+        pending_ready = max( pending_ready, reg_ready[ inst->d ] );
+      }else if( reg_form && ( ( op == 0x30 ) || ( op == 0x32 ) ) ){
+        pending_class = LAT_BR;                                  /* jmp, jsr */
+      }else if( op == 0x1b ){
+        pending_class = LAT_MUL;
+      }else if( ( op == 0x1a ) || ( op == 0x1e ) ){
+        pending_class = LAT_DIV;
+      }else{
+        pending_class = LAT_ALU;
+      }
+  }
+
+  /* loads and stores complete in on_mem() once the address is known */
+  if( ( pending_class >= 0 ) && ( pending_class != LAT_LD )
+      && ( pending_class != LAT_ST ) ){
+    complete( pending_ready + latency[ pending_class ] );
+  }
+}
+
+static void on_mem( void *ctx, unsigned int pc, unsigned int address,
+                    int is_write, unsigned int value ){
+  unsigned long long *slot = mem_slot( address );
+
+  (void)ctx;
+  (void)pc;
+  (void)value;
+
+  if( is_write ){
+    complete( pending_ready + latency[ LAT_ST ] );
+    *slot = pending_done;
+  }else{
+    complete( max( pending_ready, *slot ) + latency[ LAT_LD ] );
+  }
+}
+
+static void on_reg_write( void *ctx, unsigned int pc, int reg, unsigned int value ){
+  (void)ctx;
+  (void)pc;
+  (void)value;
+  reg_ready[ reg ] = pending_done;
+}
+
+static void on_finish( void *ctx, FILE *out ){
+  (void)ctx;
+
+  fprintf( out, "dataflow limit (in decimal):\n" );
+  fprintf( out, "  latencies           =" );
+  for( int i = 0; i < NUM_LATENCIES; i++ ){
+    fprintf( out, " %s=%llu", latency_names[ i ], latency[ i ] );
+  }
+  fprintf( out, "\n" );
+  fprintf( out, "  instructions        = %llu\n", instructions );
+  fprintf( out, "  critical path       = %llu cycles\n", critical_path );
+  fprintf( out, "  available ILP       = %.2f\n",
+    critical_path ? ((double)instructions) / critical_path : 0.0 );
+
+  if( interval_length ){
+    unsigned long long previous = 0,
+                       last_end = num_intervals
+                                ? intervals[ num_intervals - 1 ].instructions : 0;
+
+    if( instructions != last_end ) end_interval();
+    fprintf( out, "  interval  end instruction  path growth       ILP\n" );
+    for( unsigned int i = 0; i < num_intervals; i++ ){
+      struct interval *v = &intervals[ i ];
+      fprintf( out, "  %8u  %15llu  %11llu  ", i, v->instructions, v->path );
+      if( v->path ){
+        fprintf( out, "%8.2f\n", ((double)( v->instructions - previous )) / v->path );
+      }else{
+        fprintf( out, "%8s\n", "-" );
+      }
+      previous = v->instructions;
+    }
+  }
+}
+
+int sim_plugin_init( const struct sim_host *host, const char *args ){
+  struct sim_callbacks cb = { NULL, NULL, on_decode, on_mem, on_reg_write,
+                              NULL, on_finish };
+  char *copy = strdup( args ),
+       *item;
+
+  if( copy == NULL ){
+    fprintf( stderr, "dataflow: out of memory\n" );
+    return -1;
+  }
+  for( item = strtok( copy, "," ); item; item = strtok( NULL, "," ) ){
+    char *eq = strchr( item, '=' );
+    int found = 0;
+
+    if( eq == NULL ){
+      fprintf( stderr, "dataflow: expected name=value, got %s\n", item );
+      free( copy );
+      return -1;
+    }
+    *eq = '\0';
+    if( strcmp( item, "interval" ) == 0 ){
+      interval_length = strtoull( eq + 1, NULL, 0 );
+      found = 1;
+    }
+    for( int i = 0; i < NUM_LATENCIES; i++ ){
+      if( strcmp( item, latency_names[ i ] ) == 0 ){
+        latency[ i ] = strtoull( eq + 1, NULL, 0 );
+        found = 1;
+      }
+    }
+    if( !found ){
+      fprintf( stderr, "dataflow: unknown setting %s\n", item );
+      free( copy );
+      return -1;
+    }
+  }
+  free( copy );
+
+  return host->add_callbacks( &cb );
+}
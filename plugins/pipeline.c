@@ -0,0 +1,276 @@
+/* in-order pipeline and scoreboard timing plugin for the MC88100 simulators
+ *
+ * models the MC88100 issuing one instruction a cycle in program order,
+ *   with a scoreboard of the general registers: an instruction sets
+ *   the scoreboard bit of each register it writes until its result is
+ *   written back, and a later instruction that reads or writes such a
+ *   register waits to issue until the bit is clear
+ *
+ *   issue( inst ) = max( issue of the previous instruction + 1,
+ *                        ready of each source and destination register,
+ *                        the first cycle its unit accepts it )
+ *   ready( dest ) = issue( inst ) + latency( inst )
+ *
+ * the units are
+ *
+ *   integer   add, sub, lda, cmp, the logical operations, the bit
+ *               fields, and the branches, in alu cycles
+ *   data      ld and st, pipelined: one access a cycle
+ *   add pipe  fadd, fsub, flt, and int, pipelined: fadd stages
+ *   mul pipe  fmul and the integer mul, pipelined: fmul or mul stages
+ *   divider   fdiv, div, and divu, not pipelined: the next divide is
+ *               accepted when the previous one completes
+ *
+ * delayed branching is not used, so a taken branch costs taken more
+ *   cycles; r0 is always ready, and a double operand or result holds
+ *   both registers of its pair
+ *
+ * the cycle count ends when the last instruction has issued and the
+ *   last result has been written back; each stall is charged to the
+ *   constraint that held the instruction longest: a source operand, a
+ *   destination still pending, a busy unit, or a taken branch
+ *
+ * usage
+ *
+ *   cc -O2 -shared -fPIC -o pipeline.so pipeline.c
+ *   sim --plugin ./pipeline.so[:name=value,...]
+ *
+ *   names are the latencies alu, ld, st, mul, div, fadd, fmul, fdiv,
+ *   and taken, in cycles; they default to 1, 3, 1, and the MC88100's
+ *   4 and 38 cycles, and 5, 6, 30, and 1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_plugin.h"
+
+enum { LAT_ALU, LAT_LD, LAT_ST, LAT_MUL, LAT_DIV, LAT_FADD, LAT_FMUL,
+       LAT_FDIV, LAT_TAKEN, NUM_LATENCIES };
+
+static const char *latency_names[NUM_LATENCIES] = {
+  "alu", "ld", "st", "mul", "div", "fadd", "fmul", "fdiv", "taken"
+};
+
+static unsigned long long latency[NUM_LATENCIES] = {
+  1, 3, 1, 4, 38, 5, 6, 30, 1
+};
+
+enum { UNIT_INTEGER, UNIT_DATA, UNIT_ADD, UNIT_MUL, UNIT_DIV, NUM_UNITS };
+
+static const char *unit_names[NUM_UNITS] = {
+  "integer", "data", "add pipe", "mul pipe", "divider"
+};
+
+enum { STALL_SOURCE, STALL_DEST, STALL_UNIT, STALL_BRANCH, NUM_STALLS };
+
+static const char *stall_names[NUM_STALLS] = {
+  "source operand", "destination", "busy unit", "taken branch"
+};
+
+static unsigned long long reg_ready[32],
+                          unit_free[NUM_UNITS],  /* first cycle it accepts */
+                          unit_issues[NUM_UNITS],
+                          stalls[NUM_STALLS],
+                          next_issue,            /* earliest issue cycle */
+                          last_done,             /* latest write back    */
+                          instructions;
+
+static unsigned long long max( unsigned long long a, unsigned long long b ){
+  return ( a > b ) ? a : b;
+}
+
+/* the registers an instruction reads and writes */
+
+struct access {
+  unsigned int reads[4], num_reads,
+               writes[2], num_writes;
+};
+
+static void add_reg( unsigned int *list, unsigned int *n, unsigned int reg,
+                     unsigned int is_double ){
+  list[ ( *n )++ ] = reg;
+  if( is_double ) list[ ( *n )++ ] = ( reg + 1 ) & 31;
+}
+
+/* the unit and latency class of an instruction, and its registers */
+
+static void classify( const struct sim_decoded *inst, struct access *a,
+                      int *unit, int *class ){
+  int reg_form = ( inst->op1 == 0x3d );
+  unsigned int op = reg_form ? inst->op2 : inst->op1;
+
+  memset( a, 0, sizeof( struct access ) );
+  *unit = UNIT_INTEGER;
+  *class = LAT_ALU;
+
+  switch( inst->op1 ){
+    case 0x00:                                                   /* halt */
+    case 0x30: return;                                           /* br */
+    case 0x31: add_reg( a->writes, &a->num_writes, 1, 0 ); return;  /* bsr */
+    case 0x34:                                                   /* bb0, bb1, bcnd */
+    case 0x36:
+    case 0x3a: add_reg( a->reads, &a->num_reads, inst->s1, 0 ); return;
+    case 0x3c:                                                   /* bit fields */
+      add_reg( a->reads, &a->num_reads, inst->s1, 0 );
+      add_reg( a->writes, &a->num_writes, inst->d, 0 );
+      return;
+    case 0x21:{                                                  /* floating point */
+      unsigned int fop = ( inst->ir >> 11 ) & 0x1f;
+      if( ( fop != 0x04 ) && ( fop != 0x09 ) ){                  /* not flt, int */
+        add_reg( a->reads, &a->num_reads, inst->s1, ( inst->ir >> 9 ) & 1 );
+      }
+      add_reg( a->reads, &a->num_reads, inst->s2, ( inst->ir >> 7 ) & 1 );
+      add_reg( a->writes, &a->num_writes, inst->d, ( inst->ir >> 5 ) & 1 );
+      if( fop == 0x00 ){
+        *unit = UNIT_MUL;
+        *class = LAT_FMUL;
+      }else if( fop == 0x0e ){
+        *unit = UNIT_DIV;
+        *class = LAT_FDIV;
+      }else{
+        *unit = UNIT_ADD;
+        *class = LAT_FADD;
+      }
+      return;
+    }
+  }
+
+  if( reg_form && ( ( op == 0x30 ) || ( op == 0x32 ) ) ){        /* jmp, jsr */
+    add_reg( a->reads, &a->num_reads, inst->s2, 0 );
+    if( op == 0x32 ) add_reg( a->writes, &a->num_writes, 1, 0 );
+    return;
+  }
+
+  add_reg( a->reads, &a->num_reads, inst->s1, 0 );
+  if( reg_form ) add_reg( a->reads, &a->num_reads, inst->s2, 0 );
+  if( op == 0x09 ){                                              /* st */
+    add_reg( a->reads, &a->num_reads, inst->d, 0 );
+    *unit = UNIT_DATA;
+    *class = LAT_ST;
+    return;
+  }
+  add_reg( a->writes, &a->num_writes, inst->d, 0 );
+  if( op == 0x05 ){                                              /* ld */
+    *unit = UNIT_DATA;
+    *class = LAT_LD;
+  }else if( op == 0x1b ){                                        /* mul */
+    *unit = UNIT_MUL;
+    *class = LAT_MUL;
+  }else if( ( op == 0x1a ) || ( op == 0x1e ) ){                  /* divu, div */
+    *unit = UNIT_DIV;
+    *class = LAT_DIV;
+  }
+}
+
+static void on_decode( void *ctx, unsigned int pc, const struct sim_decoded *inst ){
+  struct access a;
+  unsigned long long source = 0, dest = 0, issue, done, wait[NUM_STALLS];
+  int unit, class, cause = STALL_SOURCE;
+
+  (void)ctx;
+  (void)pc;
+
+  classify( inst, &a, &unit, &class );
+  instructions++;
+
+  for( unsigned int i = 0; i < a.num_reads; i++ ){
+    if( a.reads[ i ] ) source = max( source, reg_ready[ a.reads[ i ] ] );
+  }
+  for( unsigned int i = 0; i < a.num_writes; i++ ){
+    if( a.writes[ i ] ) dest = max( dest, reg_ready[ a.writes[ i ] ] );
+  }
+
+  wait[ STALL_SOURCE ] = source;
+  wait[ STALL_DEST ] = dest;
+  wait[ STALL_UNIT ] = unit_free[ unit ];
+  for( int i = STALL_DEST; i <= STALL_UNIT; i++ ){
+    if( wait[ i ] > wait[ cause ] ) cause = i;
+  }
+  issue = max( next_issue, wait[ cause ] );
+  stalls[ cause ] += issue - next_issue;
+
+  done = issue + latency[ class ];
+  for( unsigned int i = 0; i < a.num_writes; i++ ){
+    if( a.writes[ i ] ) reg_ready[ a.writes[ i ] ] = done;
+  }
+  unit_free[ unit ] = ( unit == UNIT_DIV ) ? done : issue + 1;
+  unit_issues[ unit ]++;
+  next_issue = issue + 1;
+  last_done = max( last_done, done );
+}
+
+static void on_branch( void *ctx, unsigned int pc, unsigned int target, int taken ){
+  (void)ctx;
+  (void)pc;
+  (void)target;
+  if( taken ){
+    next_issue += latency[ LAT_TAKEN ];
+    stalls[ STALL_BRANCH ] += latency[ LAT_TAKEN ];
+  }
+}
+
+static void on_finish( void *ctx, FILE *out ){
+  unsigned long long cycles = max( next_issue, last_done ),
+                     stalled = 0;
+
+  (void)ctx;
+
+  for( int i = 0; i < NUM_STALLS; i++ ) stalled += stalls[ i ];
+
+  fprintf( out, "pipeline timing (in decimal):\n" );
+  fprintf( out, "  latencies           =" );
+  for( int i = 0; i < NUM_LATENCIES; i++ ){
+    fprintf( out, " %s=%llu", latency_names[ i ], latency[ i ] );
+  }
+  fprintf( out, "\n" );
+  fprintf( out, "  instructions        = %llu\n", instructions );
+  fprintf( out, "  cycles              = %llu\n", cycles );
+  fprintf( out, "  CPI                 = %.2f\n",
+    instructions ? ((double)cycles) / instructions : 0.0 );
+  fprintf( out, "  stall cycles        = %llu\n", stalled );
+  for( int i = 0; i < NUM_STALLS; i++ ){
+    fprintf( out, "    %-17s = %llu\n", stall_names[ i ], stalls[ i ] );
+  }
+  fprintf( out, "  issued to\n" );
+  for( int i = 0; i < NUM_UNITS; i++ ){
+    fprintf( out, "    %-17s = %llu\n", unit_names[ i ], unit_issues[ i ] );
+  }
+}
+
+int sim_plugin_init( const struct sim_host *host, const char *args ){
+  struct sim_callbacks cb = { NULL, NULL, on_decode, NULL, NULL,
+                              on_branch, on_finish };
+  char *copy = strdup( args ),
+       *item;
+
+  if( copy == NULL ){
+    fprintf( stderr, "pipeline: out of memory\n" );
+    return -1;
+  }
+  for( item = strtok( copy, "," ); item; item = strtok( NULL, "," ) ){
+    char *eq = strchr( item, '=' );
+    int found = 0;
+
+    if( eq == NULL ){
+      fprintf( stderr, "pipeline: expected name=value, got %s\n", item );
+      free( copy );
+      return -1;
+    }
+    *eq = '\0';
+    for( int i = 0; i < NUM_LATENCIES; i++ ){
+      if( strcmp( item, latency_names[ i ] ) == 0 ){
+        latency[ i ] = strtoull( eq + 1, NULL, 0 );
+        found = 1;
+      }
+    }
+    if( !found ){
+      fprintf( stderr, "pipeline: unknown setting %s\n", item );
+      free( copy );
+      return -1;
+    }
+  }
+  free( copy );
+
+  return host->add_callbacks( &cb );
+}
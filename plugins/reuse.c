@@ -0,0 +1,264 @@
+/* reuse-distance analysis plugin for the MC88100 simulators
+ *
+ * the reuse distance of a data access is the number of distinct cache
+ *   lines touched since the previous access to the same line; an
+ *   access hits in a fully-associative LRU cache of C lines exactly
+ *   when its reuse distance is less than C
+ *
+ * distances are kept per load/store address (xip) in log2 buckets
+ *
+ *   bucket 0      first touch of the line (cold)
+ *   bucket 1      distance 0
+ *   bucket b > 1  distance in [ 2^(b-2), 2^(b-1) )
+ *
+ * algorithm
+ *
+ *   every access gets a timestamp; a hash table maps each line to the
+ *   timestamp of its last access, and a Fenwick tree over timestamps
+ *   holds a 1 at the last-access time of every line; the distance of
+ *   an access at time t to a line last seen at time p is the number of
+ *   1s strictly between p and t, so each access costs O(log n)
+ *
+ *   when the timestamps reach the size of the tree, the live marks are
+ *   renumbered in order and the tree is rebuilt, at most doubling it
+ *
+ * usage
+ *
+ *   cc -O2 -shared -fPIC -o reuse.so reuse.c
+ *   sim --plugin ./reuse.so[:line=BYTES]     (default 8 bytes, the line
+ *                                            size of the cache simulator)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_plugin.h"
+
+#define NUM_BUCKETS 34
+#define EMPTY       0xffffffffu
+
+/* open-addressing hash table from a 32-bit key to a 32-bit value */
+
+struct table {
+  unsigned int *keys,
+               *values,
+               size,     /* power of two */
+               used;
+};
+
+static unsigned int hash( unsigned int key ){
+  key ^= key >> 16;
+  key *= 0x45d9f3b;
+  key ^= key >> 16;
+  return key;
+}
+
+static void table_init( struct table *t, unsigned int size ){
+  t->size = size;
+  t->used = 0;
+  t->keys = malloc( size * sizeof( unsigned int ) );
+  t->values = malloc( size * sizeof( unsigned int ) );
+  if( ( t->keys == NULL ) || ( t->values == NULL ) ){
+    fprintf( stderr, "reuse: out of memory\n" );
+    exit( -1 );
+  }
+  memset( t->keys, 0xff, size * sizeof( unsigned int ) );
+}
+
+/* returns the slot for key, inserting it with value EMPTY if absent */
+
+static unsigned int *table_slot( struct table *t, unsigned int key ){
+  unsigned int i;
+
+  if( 2 * ( t->used + 1 ) > t->size ){
+    struct table bigger;
+    table_init( &bigger, 2 * t->size );
+    for( i = 0; i < t->size; i++ ){
+      if( t->keys[ i ] != EMPTY ) *table_slot( &bigger, t->keys[ i ] ) = t->values[ i ];
+    }
+    free( t->keys );
+    free( t->values );
+    *t = bigger;
+  }
+
+  i = hash( key ) & ( t->size - 1 );
+  while( ( t->keys[ i ] != EMPTY ) && ( t->keys[ i ] != key ) ){
+    i = ( i + 1 ) & ( t->size - 1 );
+  }
+  if( t->keys[ i ] == EMPTY ){
+    t->keys[ i ] = key;
+    t->values[ i ] = EMPTY;
+    t->used++;
+  }
+  return &t->values[ i ];
+}
+
+/* Fenwick tree over timestamps 1 .. size */
+
+static unsigned int *tree,
+                    tree_size,
+                    now;       /* timestamp of the latest access */
+
+static void tree_add( unsigned int i, int delta ){
+  for( ; i <= tree_size; i += i & -i ) tree[ i ] += delta;
+}
+
+static unsigned int tree_sum( unsigned int i ){  /* marks in 1 .. i */
+  unsigned int sum = 0;
+  for( ; i > 0; i -= i & -i ) sum += tree[ i ];
+  return sum;
+}
+
+static struct table lines;     /* line address -> last timestamp */
+
+static int by_time( const void *a, const void *b ){
+  unsigned int x = **(unsigned int * const *)a,
+               y = **(unsigned int * const *)b;
+  return ( x > y ) - ( x < y );
+}
+
+/* renumber the live marks 1 .. k and rebuild the tree */
+
+static void compact(){
+  unsigned int **live = malloc( lines.used * sizeof( unsigned int * ) ),
+               k = 0;
+
+  for( unsigned int i = 0; i < lines.size; i++ ){
+    if( lines.keys[ i ] != EMPTY ) live[ k++ ] = &lines.values[ i ];
+  }
+  qsort( live, k, sizeof( unsigned int * ), by_time );
+  for( unsigned int i = 0; i < k; i++ ) *live[ i ] = i + 1;
+  free( live );
+
+  if( 2 * k > tree_size ) tree_size *= 2;
+  free( tree );
+  tree = calloc( tree_size + 1, sizeof( unsigned int ) );
+  for( unsigned int i = 1; i <= k; i++ ) tree_add( i, 1 );
+  now = k;
+}
+
+/* per-PC histograms */
+
+struct pc_hist {
+  unsigned int pc;
+  int is_store;
+  unsigned long long accesses,
+                     buckets[NUM_BUCKETS];
+};
+
+static struct pc_hist *hists;
+static unsigned int num_hists,
+                    max_hists;
+static struct table pcs;       /* pc -> index into hists */
+
+static unsigned int line_shift = 3;
+
+static int bucket_of( unsigned int distance ){
+  int b = 1;
+  while( distance ){
+    b++;
+    distance >>= 1;
+  }
+  return b;
+}
+
+static void on_mem( void *ctx, unsigned int pc, unsigned int address,
+                    int is_write, unsigned int value ){
+  unsigned int *last = table_slot( &lines, address >> line_shift ),
+               *index = table_slot( &pcs, pc );
+  struct pc_hist *h;
+  int b;
+
+  (void)ctx;
+  (void)value;
+
+  if( *index == EMPTY ){
+    if( num_hists == max_hists ){
+      max_hists = max_hists ? 2 * max_hists : 64;
+      hists = realloc( hists, max_hists * sizeof( struct pc_hist ) );
+    }
+    memset( &hists[ num_hists ], 0, sizeof( struct pc_hist ) );
+    hists[ num_hists ].pc = pc;
+    *index = num_hists++;
+  }
+  h = &hists[ *index ];
+  h->is_store |= is_write;
+
+  if( now == tree_size ) compact();
+  now++;
+
+  if( *last == EMPTY ){
+    b = 0;
+  }else{
+    b = bucket_of( tree_sum( now - 1 ) - tree_sum( *last ) );
+    tree_add( *last, -1 );
+  }
+  tree_add( now, 1 );
+  *last = now;
+
+  h->accesses++;
+  h->buckets[ b ]++;
+}
+
+static int by_accesses( const void *a, const void *b ){
+  const struct pc_hist *x = a, *y = b;
+  if( x->accesses != y->accesses ) return ( x->accesses < y->accesses ) ? 1 : -1;
+  return ( x->pc > y->pc ) - ( x->pc < y->pc );
+}
+
+static void on_finish( void *ctx, FILE *out ){
+  unsigned long long total[NUM_BUCKETS] = {0},
+                     accesses = 0,
+                     hits;
+
+  (void)ctx;
+  qsort( hists, num_hists, sizeof( struct pc_hist ), by_accesses );
+
+  fprintf( out, "reuse distance by instruction (%u-byte lines, in decimal):\n",
+    1u << line_shift );
+  fprintf( out, "  address  type    accesses  histogram (bucket:count, 0 = cold,"
+                " b = distance < 2^(b-1))\n" );
+  for( unsigned int i = 0; i < num_hists; i++ ){
+    struct pc_hist *h = &hists[ i ];
+    fprintf( out, "  %7x  %-5s %10llu ", h->pc, h->is_store ? "st" : "ld",
+      h->accesses );
+    for( int b = 0; b < NUM_BUCKETS; b++ ){
+      if( h->buckets[ b ] ) fprintf( out, " %d:%llu", b, h->buckets[ b ] );
+      total[ b ] += h->buckets[ b ];
+    }
+    fprintf( out, "\n" );
+    accesses += h->accesses;
+  }
+
+  /* distance < 2^k lines is buckets 1 .. k + 1 */
+  fprintf( out, "fully-associative LRU hit ratio by capacity (in lines):\n" );
+  hits = 0;
+  for( int b = 1; b < NUM_BUCKETS - 1; b++ ){
+    hits += total[ b ];
+    if( ( b >= 4 ) && ( b <= 16 ) ){
+      fprintf( out, "  %6u lines = %5.1f%%\n", 1u << ( b - 1 ),
+        accesses ? 100.0 * hits / accesses : 0.0 );
+    }
+  }
+}
+
+int sim_plugin_init( const struct sim_host *host, const char *args ){
+  struct sim_callbacks cb = { NULL, NULL, NULL, on_mem, NULL, NULL, on_finish };
+
+  if( strncmp( args, "line=", 5 ) == 0 ){
+    unsigned int bytes = strtoul( args + 5, NULL, 0 );
+    if( ( bytes < 4 ) || ( bytes & ( bytes - 1 ) ) ){
+      fprintf( stderr, "reuse: line size must be a power of two >= 4\n" );
+      return -1;
+    }
+    for( line_shift = 0; ( 1u << line_shift ) < bytes; line_shift++ );
+  }
+
+  table_init( &lines, 1024 );
+  table_init( &pcs, 256 );
+  tree_size = 1 << 16;
+  tree = calloc( tree_size + 1, sizeof( unsigned int ) );
+  now = 0;
+
+  return host->add_callbacks( &cb );
+}
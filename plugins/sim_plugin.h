@@ -0,0 +1,87 @@
+/* instrumentation plugin interface for the MC88100 simulators
+ *
+ * a plugin is a shared object loaded with --plugin FILE[:ARGS]; it
+ *   exports sim_plugin_init(), which is called once before the program
+ *   runs with the host interface and the text after the colon (or an
+ *   empty string), and returns 0 on success
+ *
+ *   int sim_plugin_init( const struct sim_host *host, const char *args );
+ *
+ * the plugin registers one or more sets of callbacks through
+ *   host->add_callbacks(); any callback may be NULL, and ctx is passed
+ *   back unchanged to every callback of that set
+ *
+ * callbacks are invoked in this order for each instruction
+ *
+ *   fetch      the instruction word has been fetched from pc
+ *   decode     the fields of the instruction have been extracted
+ *   mem        a data word was read or written (ld, st); value is the
+ *                word that was transferred
+ *   reg_write  a general register other than r0 was written; a double
+ *                result calls it for both registers of the pair
+ *   branch     a br, bsr, bb0, bb1, bcnd, jmp, or jsr executed; target is
+ *                the next fetch address
+ *
+ *   finish     the program halted; the plugin prints its report to
+ *                out, which is stderr when the simulator writes json
+ *                or csv statistics
+ *
+ * when no plugin is loaded the simulators run a separate instantiation
+ *   of the main loop with all of these hooks compiled out
+ *
+ * build a plugin with
+ *
+ *   cc -O2 -shared -fPIC -o myplugin.so myplugin.c
+ */
+
+#ifndef SIM_PLUGIN_H
+#define SIM_PLUGIN_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_PLUGIN_VERSION 1
+#define SIM_PLUGIN_INIT    "sim_plugin_init"
+
+/* instruction fields as extracted by decode() in lib/core.c */
+
+struct sim_decoded {
+  unsigned int ir,      /* 32-bit instruction word                  */
+               op1,     /* 6-bit primary opcode in bits 31 to 26    */
+               op2,     /* 6-bit secondary opcode in bits 15 to 10  */
+               d,       /* 5-bit destination register identifier    */
+               s1,      /* 5-bit source 1 register identifier       */
+               s2,      /* 5-bit source 2 register identifier       */
+               imm16,   /* 16-bit immediate field                   */
+               scaled;  /* scaled addressing mode bit 9             */
+};
+
+struct sim_callbacks {
+  void *ctx;
+  void (*fetch)( void *ctx, unsigned int pc, unsigned int ir );
+  void (*decode)( void *ctx, unsigned int pc, const struct sim_decoded *inst );
+  void (*mem)( void *ctx, unsigned int pc, unsigned int address,
+               int is_write, unsigned int value );
+  void (*reg_write)( void *ctx, unsigned int pc, int reg, unsigned int value );
+  void (*branch)( void *ctx, unsigned int pc, unsigned int target, int taken );
+  void (*finish)( void *ctx, FILE *out );
+};
+
+struct sim_host {
+  unsigned int version;             /* SIM_PLUGIN_VERSION             */
+  const char *simulator;            /* "mc88100" or "mc88100-cache"   */
+  int (*add_callbacks)( const struct sim_callbacks *cb );  /* 0 = ok  */
+  unsigned int (*read_word)( unsigned int address );
+};
+
+typedef int (*sim_plugin_init_fn)( const struct sim_host *host,
+                                   const char *args );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
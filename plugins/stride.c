@@ -0,0 +1,209 @@
+/* access-pattern classifier plugin for the MC88100 simulators
+ *
+ * watches the effective address of every ld and st (all addressing
+ *   modes) and classifies each memory instruction as
+ *
+ *   constant      the same address every time (stride 0)
+ *   unit-stride   consecutive words, stride +4 or -4 bytes
+ *   fixed-stride  one other stride dominates
+ *   indirect      no dominant stride, and the address is computed from
+ *                   a value that was loaded from memory
+ *   irregular     none of the above
+ *
+ * the dominant stride of each instruction is found with a space-saving
+ *   summary of NUM_STRIDES candidates; its confidence is the fraction
+ *   of the strides seen by the instruction that equal it, and a stride
+ *   class needs a confidence of at least STRIDE_THRESHOLD
+ *
+ * for the indirect class each register carries a flag that is set when
+ *   it is written by a load and propagated through add, sub, lda and
+ *   the bit-field instructions; its confidence is the fraction of the
+ *   accesses whose address registers were flagged; an instruction that
+ *   accessed memory only once is irregular with confidence 0
+ *
+ * usage
+ *
+ *   cc -O2 -shared -fPIC -o stride.so stride.c
+ *   sim --plugin ./stride.so
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_plugin.h"
+
+#define NUM_STRIDES      4
+#define STRIDE_THRESHOLD 0.5
+
+struct mem_inst {
+  unsigned int pc,
+               ir,
+               last_address;
+  int is_store,
+      strides[NUM_STRIDES];
+  unsigned long long accesses,
+                     indirect,              /* flagged address registers */
+                     counts[NUM_STRIDES];   /* space-saving estimates    */
+};
+
+static struct mem_inst *insts;
+static unsigned int num_insts,
+                    max_insts,
+                    *index_of,              /* by word address, 0 = none */
+                    index_size;
+
+static int loaded[32],          /* register holds a loaded value        */
+           pending_loaded,      /* value of the flag for the next write */
+           pending_indirect;    /* address registers of this ld/st      */
+static unsigned int pending_ir;
+
+static struct mem_inst *lookup( unsigned int pc ){
+  unsigned int word = pc >> 2;
+
+  if( word >= index_size ){
+    unsigned int size = index_size ? index_size : 1024;
+    while( size <= word ) size *= 2;
+    index_of = realloc( index_of, size * sizeof( unsigned int ) );
+    memset( index_of + index_size, 0,
+      ( size - index_size ) * sizeof( unsigned int ) );
+    index_size = size;
+  }
+  if( index_of[ word ] == 0 ){
+    if( num_insts == max_insts ){
+      max_insts = max_insts ? 2 * max_insts : 64;
+      insts = realloc( insts, max_insts * sizeof( struct mem_inst ) );
+    }
+    memset( &insts[ num_insts ], 0, sizeof( struct mem_inst ) );
+    insts[ num_insts ].pc = pc;
+    index_of[ word ] = ++num_insts;
+  }
+  return &insts[ index_of[ word ] - 1 ];
+}
+
+/* space-saving: count a known stride, take a free slot, or replace */
+/*   the smallest candidate and inherit its count                    */
+
+static void count_stride( struct mem_inst *m, int stride ){
+  int min = 0;
+
+  for( int i = 0; i < NUM_STRIDES; i++ ){
+    if( m->counts[ i ] && ( m->strides[ i ] == stride ) ){
+      m->counts[ i ]++;
+      return;
+    }
+    if( m->counts[ i ] < m->counts[ min ] ) min = i;
+  }
+  m->strides[ min ] = stride;
+  m->counts[ min ]++;
+}
+
+static void on_decode( void *ctx, unsigned int pc, const struct sim_decoded *inst ){
+  int reg_form = ( inst->op1 == 0x3d );
+  unsigned int op = reg_form ? inst->op2 : inst->op1;
+
+  (void)ctx;
+  (void)pc;
+
+  pending_ir = inst->ir;
+  pending_indirect = loaded[ inst->s1 ]
+                     || ( ( reg_form || ( inst->op1 == 0x21 ) ) && loaded[ inst->s2 ] );
+
+  if( ( inst->op1 == 0x3c ) || ( inst->op1 == 0x21 ) || ( op == 0x0d )
+      || ( ( op >= 0x1a ) && ( op <= 0x1f ) )      /* divu to cmp */
+      || ( ( op >= 0x10 ) && ( op <= 0x17 ) ) ){
+    pending_loaded = pending_indirect;   /* arithmetic, logical, bit fields */
+  }else{
+    pending_loaded = ( op == 0x05 );     /* ld */
+  }
+}
+
+static void on_reg_write( void *ctx, unsigned int pc, int reg, unsigned int value ){
+  (void)ctx;
+  (void)pc;
+  (void)value;
+  loaded[ reg ] = pending_loaded;
+}
+
+static void on_mem( void *ctx, unsigned int pc, unsigned int address,
+                    int is_write, unsigned int value ){
+  struct mem_inst *m = lookup( pc );
+
+  (void)ctx;
+  (void)value;
+
+  if( m->accesses ){
+    count_stride( m, (int)( address - m->last_address ) );
+  }else{
+    m->ir = pending_ir;
+    m->is_store = is_write;
+  }
+  m->last_address = address;
+  m->accesses++;
+  m->indirect += pending_indirect;
+}
+
+struct verdict {
+  struct mem_inst *m;
+  const char *class;
+  int stride;
+  double confidence;
+};
+
+static void classify( struct mem_inst *m, struct verdict *v ){
+  int best = 0;
+
+  for( int i = 1; i < NUM_STRIDES; i++ ){
+    if( m->counts[ i ] > m->counts[ best ] ) best = i;
+  }
+
+  v->m = m;
+  v->stride = m->strides[ best ];
+  v->confidence = ( m->accesses > 1 )
+                ? ((double)m->counts[ best ]) / ( m->accesses - 1 ) : 1.0;
+
+  if( ( m->accesses > 1 ) && ( v->confidence >= STRIDE_THRESHOLD ) ){
+    if( v->stride == 0 ) v->class = "constant";
+    else if( ( v->stride == 4 ) || ( v->stride == -4 ) ) v->class = "unit-stride";
+    else v->class = "fixed-stride";
+  }else if( m->indirect * 2 > m->accesses ){
+    v->class = "indirect";
+    v->confidence = ((double)m->indirect) / m->accesses;
+  }else{
+    v->class = "irregular";
+    v->confidence = 1.0 - v->confidence;
+  }
+}
+
+static int by_accesses( const void *a, const void *b ){
+  const struct verdict *x = a, *y = b;
+  if( x->m->accesses != y->m->accesses ){
+    return ( x->m->accesses < y->m->accesses ) ? 1 : -1;
+  }
+  return ( x->m->pc > y->m->pc ) - ( x->m->pc < y->m->pc );
+}
+
+static void on_finish( void *ctx, FILE *out ){
+  struct verdict *v = malloc( ( num_insts + 1 ) * sizeof( struct verdict ) );
+
+  (void)ctx;
+  for( unsigned int i = 0; i < num_insts; i++ ) classify( &insts[ i ], &v[ i ] );
+  qsort( v, num_insts, sizeof( struct verdict ), by_accesses );
+
+  fprintf( out, "memory access patterns (in decimal, most accesses first):\n" );
+  fprintf( out, "  address  instr     type    accesses  class          stride"
+                "  confidence\n" );
+  for( unsigned int i = 0; i < num_insts; i++ ){
+    fprintf( out, "  %7x  %08x  %-5s %10llu  %-12s %8d  %9.1f%%\n",
+      v[ i ].m->pc, v[ i ].m->ir, v[ i ].m->is_store ? "st" : "ld",
+      v[ i ].m->accesses, v[ i ].class, v[ i ].stride,
+      100.0 * v[ i ].confidence );
+  }
+  free( v );
+}
+
+int sim_plugin_init( const struct sim_host *host, const char *args ){
+  struct sim_callbacks cb = { NULL, NULL, on_decode, on_mem, on_reg_write,
+                              NULL, on_finish };
+  (void)args;
+  return host->add_callbacks( &cb );
+}
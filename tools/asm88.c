@@ -0,0 +1,654 @@
+/* assembler for the MC88100 subset implemented by the simulators
+ *
+ * accepts the syntax that the simulators print under -t, so that any
+ *   traced instruction can be assembled again, plus labels and two
+ *   directives
+ *
+ *   halt
+ *   ld   r3,r1,10        ld, st, lda, add, sub with a 16-bit immediate
+ *   add  r3,r1,r2        ld, st, lda, add, sub with three registers
+ *   ld   r3,r1[r2]       ld, st, lda with the scaled index
+ *   mul  r3,r1,r2        mul, div, divu, cmp in both forms
+ *   or.u r3,r0,1234      and, xor, or in both forms; and.u, mask,
+ *                          mask.u, xor.u, or.u with an immediate only;
+ *                          and.c, xor.c, or.c with three registers only
+ *   ext  r3,r1,4         ext, extu, mak, rot with a 5-bit offset
+ *   br   3ffffff         26-bit word displacement, or a label; bsr too
+ *   jsr  r2              jmp, jsr to the address in a register
+ *   bcnd ne0,r1,fffd     eq0 ne0 gt0 lt0 ge0 le0 always never mask=X,
+ *                          16-bit word displacement, or a label
+ *   bb1  lt,r2,fffd      bb0 and bb1 with a bit number or a cmp bit, eq
+ *                          ne gt le lt ge hi ls lo hs, a register, and
+ *                          a displacement as for bcnd
+ *   fadd.dsd r2,r4,r6    fadd, fsub, fmul, fdiv with the sizes of rD,
+ *                          rS1, and rS2, s for single and d for double
+ *   flt.ds r2,r6         flt from an integer, int to one: flt.ss,
+ *                          flt.ds, int.ss, int.sd
+ *
+ *   loop:                a label is its byte address; it may start any
+ *                          line and be used as a branch target, as a
+ *                          16-bit immediate, or by .word
+ *   .word 1234abcd       a data word
+ *   .org  1000           continue at a byte address, filling with zeros
+ *
+ * as in the trace, numbers and register numbers are hexadecimal, with
+ *   an optional 0x and an optional minus sign, except the register of
+ *   bcnd, which the trace prints in decimal; a label must contain a
+ *   character that is not a hex digit and must not be r0 to r1f, so
+ *   that "loop" is a label, "fade" is a number, and "ra" is a register;
+ *   a semicolon, #, or ( starts a comment, which also skips the
+ *   "(= decimal -1)" notes of the trace
+ *
+ * the input is read whole and assembled in two passes, the first to
+ *   place the labels and the second to encode; a million-line program
+ *   takes a fraction of a second
+ *
+ * usage
+ *
+ *   cc -O2 -o asm88 asm88.c
+ *   asm88 [-b] [-o OUT] [FILE]    (default stdin and stdout)
+ *
+ *   the output is one hex word per line, the format of the tc*.in
+ *   files; -b writes big-endian binary words instead, for sim --binary
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char *file_name = "-";
+static int line_number;
+
+static void error( const char *message, const char *text, int length ){
+  fprintf( stderr, "%s:%d: %s", file_name, line_number, message );
+  if( text ) fprintf( stderr, " '%.*s'", length, text );
+  fprintf( stderr, "\n" );
+  exit( -1 );
+}
+
+/* labels, in an open-addressing hash table of names in the input */
+
+struct label {
+  const char *name;   /* NULL for an empty slot */
+  int length;
+  unsigned int address;
+};
+
+static struct label *labels;
+static unsigned int label_slots,   /* power of two */
+                    label_count;
+
+static unsigned int hash( const char *s, int n ){
+  unsigned int h = 2166136261u;
+  for( int i = 0; i < n; i++ ) h = ( h ^ (unsigned char)s[ i ] ) * 16777619u;
+  return h;
+}
+
+static struct label *find_label( const char *name, int length ){
+  unsigned int i = hash( name, length ) & ( label_slots - 1 );
+
+  while( labels[ i ].name && ( ( labels[ i ].length != length )
+         || memcmp( labels[ i ].name, name, length ) ) ){
+    i = ( i + 1 ) & ( label_slots - 1 );
+  }
+  return &labels[ i ];
+}
+
+static void add_label( const char *name, int length, unsigned int address ){
+  struct label *l;
+
+  if( 2 * ( label_count + 1 ) > label_slots ){
+    struct label *old = labels;
+    unsigned int old_slots = label_slots;
+
+    label_slots = label_slots ? 2 * label_slots : 1024;
+    labels = calloc( label_slots, sizeof( struct label ) );
+    if( labels == NULL ) error( "out of memory", NULL, 0 );
+    for( unsigned int i = 0; i < old_slots; i++ ){
+      if( old[ i ].name ) *find_label( old[ i ].name, old[ i ].length ) = old[ i ];
+    }
+    free( old );
+  }
+  l = find_label( name, length );
+  if( l->name ) error( "label defined twice", name, length );
+  l->name = name;
+  l->length = length;
+  l->address = address;
+  label_count++;
+}
+
+/* tokens */
+
+static int is_name_char( int c ){
+  return isalnum( c ) || ( c == '_' ) || ( c == '.' );
+}
+
+static const char *skip_space( const char *p, const char *end ){
+  while( ( p < end ) && ( ( *p == ' ' ) || ( *p == '\t' ) ) ) p++;
+  return p;
+}
+
+/* the end of the useful part of a line, before any comment */
+
+static const char *line_end( const char *p, const char *end ){
+  const char *q = p;
+  while( ( q < end ) && ( *q != ';' ) && ( *q != '#' ) && ( *q != '(' ) ) q++;
+  while( ( q > p ) && isspace( (unsigned char)q[ -1 ] ) ) q--;
+  return q;
+}
+
+static int is_number( const char *s, int n ){
+  int i = 0;
+
+  if( ( n > 0 ) && ( s[ 0 ] == '-' ) ) i++;
+  if( ( n - i > 2 ) && ( s[ i ] == '0' ) && ( ( s[ i + 1 ] | 0x20 ) == 'x' ) ) i += 2;
+  if( i == n ) return 0;
+  for( ; i < n; i++ ) if( !isxdigit( (unsigned char)s[ i ] ) ) return 0;
+  return 1;
+}
+
+static unsigned int number( const char *s, int n, int base ){
+  unsigned long long v = 0;
+  int negative = 0, i = 0;
+
+  if( ( n > 0 ) && ( s[ 0 ] == '-' ) ){
+    negative = 1;
+    i++;
+  }
+  if( ( n - i > 2 ) && ( s[ i ] == '0' ) && ( ( s[ i + 1 ] | 0x20 ) == 'x' ) ) i += 2;
+  if( i == n ) error( "expected a number", s, n );
+  for( ; i < n; i++ ){
+    int c = (unsigned char)s[ i ], digit;
+    if( isdigit( c ) ) digit = c - '0';
+    else if( isxdigit( c ) ) digit = ( c | 0x20 ) - 'a' + 10;
+    else digit = base;
+    if( digit >= base ) error( "bad number", s, n );
+    v = v * base + digit;
+    if( v > 0xffffffffULL ) error( "number too large", s, n );
+  }
+  return negative ? -(unsigned int)v : (unsigned int)v;
+}
+
+/* an operand is the text up to the next comma */
+
+struct operand {
+  const char *text;
+  int length;
+};
+
+static int split( const char *p, const char *end, struct operand *ops, int max ){
+  int n = 0;
+
+  p = skip_space( p, end );
+  if( p == end ) return 0;
+  for( ;; ){
+    const char *start = p, *stop;
+    while( ( p < end ) && ( *p != ',' ) ) p++;
+    stop = p;
+    while( ( stop > start ) && isspace( (unsigned char)stop[ -1 ] ) ) stop--;
+    if( n == max ) error( "too many operands", NULL, 0 );
+    ops[ n ].text = start;
+    ops[ n ].length = stop - start;
+    n++;
+    if( p == end ) return n;
+    p = skip_space( p + 1, end );
+  }
+}
+
+static unsigned int reg( struct operand *op, int base ){
+  unsigned int r;
+  if( ( op->length < 2 ) || ( op->text[ 0 ] != 'r' ) ){
+    error( "expected a register", op->text, op->length );
+  }
+  r = number( op->text + 1, op->length - 1, base );
+  if( r > 31 ) error( "no such register", op->text, op->length );
+  return r;
+}
+
+/* r0 to r1f are always registers, never labels */
+
+static int is_reg_name( const char *s, int n ){
+  return ( n >= 2 ) && ( n <= 3 ) && ( s[ 0 ] == 'r' ) && ( s[ 1 ] != '-' )
+      && is_number( s + 1, n - 1 ) && ( number( s + 1, n - 1, 16 ) < 32 );
+}
+
+static int is_reg( struct operand *op ){
+  return is_reg_name( op->text, op->length );
+}
+
+/* a number, or the address of a label */
+
+static unsigned int value( struct operand *op ){
+  struct label *l;
+
+  if( is_number( op->text, op->length ) ) return number( op->text, op->length, 16 );
+  if( label_count == 0 ) error( "undefined label", op->text, op->length );
+  l = find_label( op->text, op->length );
+  if( l->name == NULL ) error( "undefined label", op->text, op->length );
+  return l->address;
+}
+
+static unsigned int field( struct operand *op, int bits ){
+  unsigned int v = value( op ),
+               mask = ( 1u << bits ) - 1;
+  if( ( v > mask ) && ( ( v | mask ) != 0xffffffffu ) ){
+    error( "value does not fit the field", op->text, op->length );
+  }
+  return v & mask;
+}
+
+/* a branch target: a label, or the displacement field as printed */
+
+static unsigned int displacement( struct operand *op, unsigned int pc, int bits ){
+  unsigned int mask = ( 1u << bits ) - 1,
+               disp;
+
+  if( is_number( op->text, op->length ) ){
+    disp = field( op, bits );
+  }else{
+    int words = (int)( value( op ) - pc ) >> 2;
+    if( ( words < -( 1 << ( bits - 1 ) ) ) || ( words >= ( 1 << ( bits - 1 ) ) ) ){
+      error( "branch target out of range", op->text, op->length );
+    }
+    disp = words & mask;
+  }
+  if( disp == 0 ) error( "branch displacement is zero", op->text, op->length );
+  return disp;
+}
+
+/* instruction table */
+
+enum { F_NONE, F_MEM, F_ALU, F_IMM, F_REG, F_FIELD, F_BR, F_JMP, F_BCND,
+       F_BB, F_FP, F_FLT, F_INT, F_WORD, F_ORG };
+
+static struct mnemonic {
+  const char *name;
+  int format;
+  unsigned int code;   /* op1 of the immediate form, op2, or the */
+                       /*   floating point opcode in bits 15-11  */
+} mnemonics[] = {
+  { "halt", F_NONE,  0x00 },
+  { "ld",   F_MEM,   0x05 },
+  { "st",   F_MEM,   0x09 },
+  { "lda",  F_MEM,   0x0d },
+  { "add",  F_ALU,   0x1c },
+  { "sub",  F_ALU,   0x1d },
+  { "mul",  F_ALU,   0x1b },
+  { "div",  F_ALU,   0x1e },
+  { "divu", F_ALU,   0x1a },
+  { "cmp",  F_ALU,   0x1f },
+  { "and",  F_ALU,   0x10 },
+  { "and.u", F_IMM,  0x11 },
+  { "and.c", F_REG,  0x11 },
+  { "mask", F_IMM,   0x12 },
+  { "mask.u", F_IMM, 0x13 },
+  { "xor",  F_ALU,   0x14 },
+  { "xor.u", F_IMM,  0x15 },
+  { "xor.c", F_REG,  0x15 },
+  { "or",   F_ALU,   0x16 },
+  { "or.u", F_IMM,   0x17 },
+  { "or.c", F_REG,   0x17 },
+  { "ext",  F_FIELD, 0x24 },
+  { "extu", F_FIELD, 0x26 },
+  { "mak",  F_FIELD, 0x28 },
+  { "rot",  F_FIELD, 0x2a },
+  { "br",   F_BR,    0x30 },
+  { "bsr",  F_BR,    0x31 },
+  { "jmp",  F_JMP,   0x30 },
+  { "jsr",  F_JMP,   0x32 },
+  { "bcnd", F_BCND,  0x3a },
+  { "bb0",  F_BB,    0x34 },
+  { "bb1",  F_BB,    0x36 },
+  { "fadd", F_FP,    0x05 },
+  { "fsub", F_FP,    0x06 },
+  { "fmul", F_FP,    0x00 },
+  { "fdiv", F_FP,    0x0e },
+  { "flt",  F_FLT,   0x04 },
+  { "int",  F_INT,   0x09 },
+  { ".word", F_WORD, 0 },
+  { ".org", F_ORG,   0 },
+  { NULL,   0,       0 }
+};
+
+static int is_fp( struct mnemonic *m ){
+  return ( m->format == F_FP ) || ( m->format == F_FLT ) || ( m->format == F_INT );
+}
+
+/* a floating point mnemonic is followed by a dot and its operand sizes */
+
+static struct mnemonic *lookup( const char *s, int n ){
+  for( struct mnemonic *m = mnemonics; m->name; m++ ){
+    int k = strlen( m->name );
+    if( ( ( k == n ) || ( is_fp( m ) && ( k < n ) && ( s[ k ] == '.' ) ) )
+        && ( memcmp( m->name, s, k ) == 0 ) ){
+      return m;
+    }
+  }
+  error( "unknown instruction", s, n );
+  return NULL;
+}
+
+/* the T1, T2, and TD fields from the sizes of rD, rS1, and rS2 in */
+/*   fadd.dss; flt has rD and s for the integer in rS2, and int has */
+/*   s for the integer in rD and rS2                                */
+
+static unsigned int sizes( struct mnemonic *m, const char *s, int n ){
+  const char *suffix = s + strlen( m->name ) + 1;
+  int length = n - strlen( m->name ) - 1;
+  unsigned int t[3] = { 0, 0, 0 };
+
+  if( length != ( ( m->format == F_FP ) ? 3 : 2 ) ){
+    error( "expected the operand sizes", s, n );
+  }
+  for( int i = 0; i < length; i++ ){
+    if( suffix[ i ] == 'd' ) t[ i ] = 1;
+    else if( suffix[ i ] != 's' ) error( "unknown operand size", s, n );
+  }
+  switch( m->format ){
+    case F_FP:
+      return ( t[ 1 ] << 4 ) | ( t[ 2 ] << 2 ) | t[ 0 ];
+    case F_FLT:
+      if( t[ 1 ] ) error( "flt converts an integer", s, n );
+      return t[ 0 ];
+    default:
+      if( t[ 0 ] ) error( "int gives an integer", s, n );
+      return t[ 1 ] << 2;
+  }
+}
+
+static unsigned int condition( struct operand *op ){
+  static const struct { const char *name; unsigned int mask; } conds[] = {
+    { "eq0", 0x2 }, { "ne0", 0xd }, { "gt0", 0x1 }, { "lt0", 0xc },
+    { "ge0", 0x3 }, { "le0", 0xe }, { "always", 0xf }, { "never", 0x0 }
+  };
+
+  for( int i = 0; i < 8; i++ ){
+    if( ( (int)strlen( conds[ i ].name ) == op->length )
+        && ( memcmp( conds[ i ].name, op->text, op->length ) == 0 ) ){
+      return conds[ i ].mask;
+    }
+  }
+  if( ( op->length > 5 ) && ( memcmp( op->text, "mask=", 5 ) == 0 ) ){
+    unsigned int mask = number( op->text + 5, op->length - 5, 16 );
+    if( mask > 0x1f ) error( "mask does not fit", op->text, op->length );
+    return mask;
+  }
+  error( "unknown condition", op->text, op->length );
+  return 0;
+}
+
+/* the bit of bb0 and bb1: a bit of the cmp result by name, or a number */
+
+static unsigned int bit( struct operand *op ){
+  static const char *names[] = {
+    "eq", "ne", "gt", "le", "lt", "ge", "hi", "ls", "lo", "hs"
+  };
+
+  for( int i = 0; i < 10; i++ ){
+    if( ( op->length == 2 ) && ( memcmp( names[ i ], op->text, 2 ) == 0 ) ){
+      return i + 2;
+    }
+  }
+  return field( op, 5 );
+}
+
+static void expect( int n, int wanted, struct mnemonic *m ){
+  if( n != wanted ){
+    fprintf( stderr, "%s:%d: %s takes %d operands\n", file_name, line_number,
+      m->name, wanted );
+    exit( -1 );
+  }
+}
+
+/* encode one instruction; name is its mnemonic and pc its byte address */
+
+static unsigned int encode( struct mnemonic *m, const char *name, int length,
+                            struct operand *ops, int n, unsigned int pc ){
+  switch( m->format ){
+    case F_NONE:
+      expect( n, 0, m );
+      return 0;
+
+    case F_MEM:
+    case F_ALU:
+    case F_IMM:
+    case F_REG:
+      if( n == 2 ){
+        /* scaled index: rS1[rS2] */
+        struct operand base = ops[ 1 ], index;
+        const char *open = memchr( base.text, '[', base.length );
+        if( ( m->format != F_MEM ) || ( open == NULL )
+            || ( base.text[ base.length - 1 ] != ']' ) ){
+          expect( n, 3, m );
+        }
+        index.text = open + 1;
+        index.length = base.length - ( open - base.text ) - 2;
+        base.length = open - base.text;
+        return ( 0x3du << 26 ) | ( reg( &ops[ 0 ], 16 ) << 21 )
+             | ( reg( &base, 16 ) << 16 ) | ( m->code << 10 ) | ( 1 << 9 )
+             | reg( &index, 16 );
+      }
+      expect( n, 3, m );
+      if( ( m->format == F_IMM ) && is_reg( &ops[ 2 ] ) ){
+        error( "expected an immediate", ops[ 2 ].text, ops[ 2 ].length );
+      }
+      if( ( m->format == F_REG ) || is_reg( &ops[ 2 ] ) ){
+        return ( 0x3du << 26 ) | ( reg( &ops[ 0 ], 16 ) << 21 )
+             | ( reg( &ops[ 1 ], 16 ) << 16 ) | ( m->code << 10 )
+             | reg( &ops[ 2 ], 16 );
+      }
+      return ( m->code << 26 ) | ( reg( &ops[ 0 ], 16 ) << 21 )
+           | ( reg( &ops[ 1 ], 16 ) << 16 ) | field( &ops[ 2 ], 16 );
+
+    case F_FIELD:
+      expect( n, 3, m );
+      return ( 0x3cu << 26 ) | ( reg( &ops[ 0 ], 16 ) << 21 )
+           | ( reg( &ops[ 1 ], 16 ) << 16 ) | ( m->code << 10 )
+           | field( &ops[ 2 ], 5 );
+
+    case F_BR:
+      expect( n, 1, m );
+      return ( m->code << 26 ) | displacement( &ops[ 0 ], pc, 26 );
+
+    case F_JMP:
+      expect( n, 1, m );
+      return ( 0x3du << 26 ) | ( m->code << 10 ) | reg( &ops[ 0 ], 16 );
+
+    case F_BCND:
+      expect( n, 3, m );
+      return ( 0x3au << 26 ) | ( condition( &ops[ 0 ] ) << 21 )
+           | ( reg( &ops[ 1 ], 10 ) << 16 ) | displacement( &ops[ 2 ], pc, 16 );
+
+    case F_BB:
+      expect( n, 3, m );
+      return ( m->code << 26 ) | ( bit( &ops[ 0 ] ) << 21 )
+           | ( reg( &ops[ 1 ], 16 ) << 16 ) | displacement( &ops[ 2 ], pc, 16 );
+
+    case F_FP:
+      expect( n, 3, m );
+      return ( 0x21u << 26 ) | ( reg( &ops[ 0 ], 16 ) << 21 )
+           | ( reg( &ops[ 1 ], 16 ) << 16 ) | ( m->code << 11 )
+           | ( sizes( m, name, length ) << 5 ) | reg( &ops[ 2 ], 16 );
+
+    case F_FLT:
+    case F_INT:
+      expect( n, 2, m );
+      return ( 0x21u << 26 ) | ( reg( &ops[ 0 ], 16 ) << 21 ) | ( m->code << 11 )
+           | ( sizes( m, name, length ) << 5 ) | reg( &ops[ 1 ], 16 );
+
+    case F_WORD:
+      expect( n, 1, m );
+      return value( &ops[ 0 ] );
+  }
+  return 0;
+}
+
+/* one pass over the input; the first places labels, the second */
+/*   also encodes into words[]                                  */
+
+static unsigned int *words;
+static unsigned int num_words,    /* highest word written + 1 */
+                    max_words;
+
+static void emit( unsigned int pc, unsigned int word ){
+  unsigned int i = pc >> 2;
+
+  if( i >= max_words ){
+    unsigned int size = max_words ? max_words : 4096;
+    while( size <= i ) size *= 2;
+    words = realloc( words, size * sizeof( unsigned int ) );
+    if( words == NULL ) error( "out of memory", NULL, 0 );
+    memset( words + max_words, 0, ( size - max_words ) * sizeof( unsigned int ) );
+    max_words = size;
+  }
+  words[ i ] = word;
+  if( i >= num_words ) num_words = i + 1;
+}
+
+static void assemble( const char *text, const char *text_end, int encoding ){
+  const char *p = text;
+  unsigned int pc = 0;
+
+  line_number = 0;
+  while( p < text_end ){
+    const char *eol = memchr( p, '\n', text_end - p ),
+               *end, *name;
+    struct operand ops[4];
+    struct mnemonic *m;
+    unsigned int address;
+    int n;
+
+    if( eol == NULL ) eol = text_end;
+    line_number++;
+    end = line_end( p, eol );
+    p = skip_space( p, end );
+
+    /* labels */
+    for( ;; ){
+      const char *q = p;
+      while( ( q < end ) && is_name_char( *q ) ) q++;
+      if( ( q == p ) || ( q == end ) || ( *q != ':' ) ) break;
+      if( !encoding ){
+        if( is_number( p, q - p ) || is_reg_name( p, q - p ) ){
+          error( "a label cannot be a number or a register", p, q - p );
+        }
+        add_label( p, q - p, pc );
+      }
+      p = skip_space( q + 1, end );
+    }
+
+    if( p < end ){
+      name = p;
+      while( ( p < end ) && is_name_char( *p ) ) p++;
+      m = lookup( name, p - name );
+      if( m->format == F_ORG ){
+        n = split( p, end, ops, 4 );
+        expect( n, 1, m );
+        if( !is_number( ops[ 0 ].text, ops[ 0 ].length ) ){
+          error( ".org needs a number", ops[ 0 ].text, ops[ 0 ].length );
+        }
+        address = number( ops[ 0 ].text, ops[ 0 ].length, 16 );
+        if( ( address & 3 ) || ( address < pc ) ){
+          error( ".org must move forward to a word address",
+            ops[ 0 ].text, ops[ 0 ].length );
+        }
+        pc = address;
+      }else{
+        if( encoding ){
+          n = split( p, end, ops, 4 );
+          emit( pc, encode( m, name, p - name, ops, n, pc ) );
+        }
+        pc += 4;
+      }
+    }
+    p = eol + 1;
+  }
+}
+
+static char *read_all( FILE *f, size_t *length ){
+  size_t size = 1 << 20, used = 0, got;
+  char *buf = malloc( size );
+
+  while( buf && ( got = fread( buf + used, 1, size - used, f ) ) > 0 ){
+    used += got;
+    if( used == size ) buf = realloc( buf, size *= 2 );
+  }
+  if( buf == NULL ) error( "out of memory", NULL, 0 );
+  *length = used;
+  return buf;
+}
+
+static void write_hex( FILE *out ){
+  static const char digits[] = "0123456789abcdef";
+  char *buf = malloc( 9 * (size_t)num_words + 1 ), *q = buf;
+
+  if( buf == NULL ) error( "out of memory", NULL, 0 );
+  for( unsigned int i = 0; i < num_words; i++ ){
+    for( int shift = 28; shift >= 0; shift -= 4 ) *q++ = digits[ ( words[ i ] >> shift ) & 0xf ];
+    *q++ = '\n';
+  }
+  fwrite( buf, 1, q - buf, out );
+  free( buf );
+}
+
+static void write_binary( FILE *out ){
+  unsigned char *buf = malloc( 4 * (size_t)num_words + 1 ), *q = buf;
+
+  if( buf == NULL ) error( "out of memory", NULL, 0 );
+  for( unsigned int i = 0; i < num_words; i++ ){
+    *q++ = words[ i ] >> 24;
+    *q++ = words[ i ] >> 16;
+    *q++ = words[ i ] >> 8;
+    *q++ = words[ i ];
+  }
+  fwrite( buf, 1, q - buf, out );
+  free( buf );
+}
+
+int main( int argc, char **argv ){
+  const char *out_name = NULL;
+  int binary = 0;
+  FILE *in = stdin, *out = stdout;
+  size_t length;
+  char *text;
+
+  for( int i = 1; i < argc; i++ ){
+    if( strcmp( argv[i], "-b" ) == 0 ){
+      binary = 1;
+    }else if( ( strcmp( argv[i], "-o" ) == 0 ) && ( i + 1 < argc ) ){
+      out_name = argv[++i];
+    }else if( ( argv[i][0] != '-' ) && ( in == stdin ) ){
+      file_name = argv[i];
+      in = fopen( file_name, "r" );
+      if( in == NULL ){
+        fprintf( stderr, "cannot open %s\n", file_name );
+        exit( -1 );
+      }
+    }else{
+      fprintf( stderr, "usage: %s [-b] [-o OUT] [FILE]\n", argv[0] );
+      fprintf( stderr, "  assembles FILE (default stdin) into hex words,"
+                       " or big-endian binary with -b\n" );
+      exit( -1 );
+    }
+  }
+
+  text = read_all( in, &length );
+  assemble( text, text + length, 0 );
+  assemble( text, text + length, 1 );
+
+  if( out_name ){
+    out = fopen( out_name, binary ? "wb" : "w" );
+    if( out == NULL ){
+      fprintf( stderr, "cannot open %s\n", out_name );
+      exit( -1 );
+    }
+  }
+  if( binary ) write_binary( out );
+  else write_hex( out );
+  if( fclose( out ) != 0 ){
+    fprintf( stderr, "cannot write the output\n" );
+    exit( -1 );
+  }
+  return 0;
+}
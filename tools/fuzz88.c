@@ -0,0 +1,766 @@
+/* random program generator and fuzzer for the MC88100 simulators
+ *
+ * generates random programs from the implemented instruction subset
+ *   that always halt, runs each one in-process with libsim88 on every
+ *   engine, and checks that they agree with each other on the core
+ *   statistics and the final registers; the engines are
+ *
+ *   switch    the switch engine
+ *   threaded  the threaded engine
+ *   lockstep  the threaded engine with the data cache, checked against
+ *               the switch engine at every block with --lockstep
+ *
+ * each worker thread runs its own contexts, so that the executions per
+ *   second measure decode and dispatch rather than process startup;
+ *   --sim PATH also runs each program on a simulator program, under
+ *   --lockstep, and compares it the same way, to check one build
+ *   against another
+ *
+ * a program is a prologue, a number of segments, and halt; a segment
+ *   is a counted loop ( r2 = trips; body; sub; bcnd ne0 ) or a single
+ *   pass over its body; a body is random instructions drawn with the
+ *   weights of --mix from
+ *
+ *   alu     add, sub, lda, and, xor, or, mul, immediate and register
+ *             forms, and.u, mask, mask.u, xor.u, or.u, and.c, xor.c,
+ *             or.c, scaled lda, and div and divu by a nonzero immediate
+ *             or by a register forced odd in r6, and cmp; one time
+ *             in eight, fadd, fsub, fmul, or fdiv with random sizes,
+ *             flt, or int of a single made by flt from half a register
+ *   shift   ext, extu, mak, rot with a random offset
+ *   load    ld, store  st, with the address from --pattern
+ *   branch  a bcnd, bb0, bb1, or br that skips forward over one to four
+ *             instructions, so that every program terminates, or, one
+ *             time in four, a call of a subroutine placed inline
+ *
+ * registers
+ *
+ *   r1 data base, r2 loop counter, r3 stride index, r4 random state,
+ *   r5 masked word index, r6 scratch for the generator, r8 to r1f and
+ *   r0 (which must stay 0) are written by random instructions
+ *
+ * memory accesses stay in a data region of --footprint bytes at DATA;
+ *   the pattern of each access is
+ *
+ *   imm     ld/st rD,r1,OFFSET with a random word offset
+ *   stride  r3 += --stride words, then ld/st rD,r1[r3 mod footprint]
+ *   random  r4 = 5 * r4 + 12345, then ld/st rD,r1[top bits of r4]
+ *
+ * a forward skip is taken with probability --taken percent, using the
+ *   always and never masks, except that --data-branches percent of
+ *   the skips test a random register with a random mask instead, or
+ *   a random bit of it with bb0 or bb1, or a bit of the cmp of two
+ *   random registers with bb0 or bb1
+ *
+ * every program is generated from the seed and its index, so that
+ *   --emit INDEX reproduces it; failing programs are saved as
+ *   DIR/fuzz-SEED-INDEX.in with --keep DIR
+ *
+ * usage
+ *
+ *   cc -O2 -pthread -o fuzz88 fuzz88.c libsim88.a -ldl
+ *   fuzz88 [--sim PATH ...] [-n PROGRAMS] [-j THREADS]
+ *          [-s SEED] [--mix alu=W,shift=W,load=W,store=W,branch=W]
+ *          [--footprint BYTES] [--pattern imm|stride|random|all]
+ *          [--stride WORDS] [--taken PCT] [--data-branches PCT]
+ *          [--segments N] [--body N] [--trips N] [--keep DIR]
+ *   fuzz88 [options] --emit INDEX > prog.in
+ */
+
+#define _GNU_SOURCE   /* pipe2 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "../lib/sim88.h"
+
+extern char **environ;
+
+#define DATA          0x80000u    /* byte address of the data region */
+#define MAX_FOOTPRINT 0x80000u    /* up to the end of the 1 MiB memory */
+#define MAX_SIMS      8
+#define OUTPUT_SIZE   ( 1 << 16 )
+
+enum { C_ALU, C_SHIFT, C_LOAD, C_STORE, C_BRANCH, NUM_CLASSES };
+
+static const char *class_names[NUM_CLASSES] = {
+  "alu", "shift", "load", "store", "branch"
+};
+
+enum { PAT_IMM, PAT_STRIDE, PAT_RANDOM, PAT_ALL };
+
+/* settings */
+
+static unsigned int weights[NUM_CLASSES] = { 4, 2, 2, 1, 1 },
+                    footprint = 16384,
+                    stride = 1,
+                    taken = 50,
+                    data_branches = 50,
+                    segments = 8,
+                    body = 32,
+                    trips = 64;
+static int pattern = PAT_ALL;
+static unsigned long long seed = 1;
+
+static const char *sims[MAX_SIMS];
+static int num_sims = 0;
+static const char *keep_dir = NULL;
+
+/* random numbers, xorshift64* seeded by splitmix64 of seed and index */
+
+struct rng {
+  unsigned long long s;
+};
+
+static void rng_init( struct rng *r, unsigned long long index ){
+  unsigned long long z = seed + index * 0x9e3779b97f4a7c15ULL;
+  z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+  z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+  r->s = ( z ^ ( z >> 31 ) ) | 1;
+}
+
+static unsigned int rnd( struct rng *r, unsigned int n ){  /* 0 .. n-1 */
+  r->s ^= r->s >> 12;
+  r->s ^= r->s << 25;
+  r->s ^= r->s >> 27;
+  return (unsigned int)( ( ( r->s * 0x2545f4914f6cdd1dULL ) >> 32 ) % n );
+}
+
+/* encoding, see the header of lib/core.c */
+
+struct program {
+  unsigned int *words,
+               count,
+               max;
+};
+
+static void emit( struct program *p, unsigned int word ){
+  if( p->count == p->max ){
+    p->max = p->max ? 2 * p->max : 1024;
+    p->words = realloc( p->words, p->max * sizeof( unsigned int ) );
+    if( p->words == NULL ){
+      fprintf( stderr, "fuzz88: out of memory\n" );
+      exit( -1 );
+    }
+  }
+  p->words[ p->count++ ] = word;
+}
+
+static void imm( struct program *p, unsigned int op1, unsigned int d,
+                 unsigned int s1, unsigned int imm16 ){
+  emit( p, ( op1 << 26 ) | ( d << 21 ) | ( s1 << 16 ) | ( imm16 & 0xffff ) );
+}
+
+static void triadic( struct program *p, unsigned int op2, unsigned int d,
+                     unsigned int s1, unsigned int s2, unsigned int scaled ){
+  emit( p, ( 0x3du << 26 ) | ( d << 21 ) | ( s1 << 16 ) | ( op2 << 10 )
+         | ( scaled << 9 ) | s2 );
+}
+
+static void bitfield( struct program *p, unsigned int op2, unsigned int d,
+                      unsigned int s1, unsigned int o5 ){
+  emit( p, ( 0x3cu << 26 ) | ( d << 21 ) | ( s1 << 16 ) | ( op2 << 10 ) | o5 );
+}
+
+static void bcnd( struct program *p, unsigned int mask, unsigned int s1, int disp ){
+  emit( p, ( 0x3au << 26 ) | ( mask << 21 ) | ( s1 << 16 ) | ( disp & 0xffff ) );
+}
+
+static void bb( struct program *p, unsigned int value, unsigned int bit,
+                unsigned int s1, int disp ){
+  emit( p, ( ( value ? 0x36u : 0x34u ) << 26 ) | ( bit << 21 ) | ( s1 << 16 )
+         | ( disp & 0xffff ) );
+}
+
+static void br( struct program *p, int disp ){
+  emit( p, ( 0x30u << 26 ) | ( disp & 0x03ffffff ) );
+}
+
+static void fp( struct program *p, unsigned int op, unsigned int d,
+                unsigned int s1, unsigned int s2, unsigned int types ){
+  emit( p, ( 0x21u << 26 ) | ( d << 21 ) | ( s1 << 16 ) | ( op << 11 )
+         | ( types << 5 ) | s2 );
+}
+
+static void li( struct program *p, unsigned int d, unsigned int value ){
+  imm( p, 0x17, d, 0, value >> 16 );             /* or.u */
+  imm( p, 0x16, d, d, value & 0xffff );          /* or */
+}
+
+static unsigned int log2_of( unsigned int n ){
+  unsigned int k = 0;
+  while( ( 1u << k ) < n ) k++;
+  return k;
+}
+
+/* any register as a source, r8 to r31 or occasionally r0 as a result */
+
+static unsigned int source( struct rng *r ){ return rnd( r, 32 ); }
+
+static unsigned int dest( struct rng *r ){
+  return rnd( r, 16 ) ? 8 + rnd( r, 24 ) : 0;
+}
+
+static void memory_op( struct program *p, struct rng *r, int is_store ){
+  unsigned int op = is_store ? 0x09 : 0x05,
+               d = is_store ? source( r ) : dest( r ),
+               words = footprint / 4,
+               k = log2_of( words ),
+               kind = ( pattern == PAT_ALL ) ? rnd( r, 3 ) : (unsigned int)pattern;
+
+  switch( kind ){
+    case PAT_IMM:{
+      unsigned int limit = ( footprint < 0x10000 ) ? words : 0x4000;
+      imm( p, op, d, 1, 4 * rnd( r, limit ) );
+      break;
+    }
+    case PAT_STRIDE:
+      if( stride < 0x10000 ) imm( p, 0x1c, 3, 3, stride );
+      else triadic( p, 0x1c, 3, 3, 7, 0 );       /* r7 holds a large stride */
+      bitfield( p, 0x28, 5, 3, 32 - k );         /* mak  r5,r3,32-k */
+      bitfield( p, 0x26, 5, 5, 32 - k );         /* extu r5,r5,32-k */
+      triadic( p, op, d, 1, 5, 1 );
+      break;
+    default:
+      bitfield( p, 0x28, 6, 4, 2 );              /* r4 = 5 * r4 + 12345 */
+      triadic( p, 0x1c, 4, 6, 4, 0 );
+      imm( p, 0x1c, 4, 4, 12345 );
+      bitfield( p, 0x26, 5, 4, 32 - k );         /* top k bits */
+      triadic( p, op, d, 1, 5, 1 );
+  }
+}
+
+/* a double result goes to a pair in r8 to r1f; int converts a value */
+/*   that fits, so that it never traps                              */
+
+static void fp_op( struct program *p, struct rng *r ){
+  static const unsigned int ops[4] = { 0x05, 0x06, 0x00, 0x0e };
+  unsigned int t1 = rnd( r, 2 ), t2 = rnd( r, 2 ), td = rnd( r, 2 ),
+               d = td ? 8 + rnd( r, 24 ) : dest( r );
+
+  switch( rnd( r, 6 ) ){
+    case 0:
+      fp( p, 0x04, d, 0, source( r ), td );                     /* flt */
+      break;
+    case 1:
+      bitfield( p, 0x24, 6, source( r ), 1 );                   /* ext  r6,rS,1 */
+      fp( p, 0x04, 6, 0, 6, 0 );                                /* flt.ss r6,r6 */
+      fp( p, 0x09, dest( r ), 0, 6, 0 );                        /* int.ss rD,r6 */
+      break;
+    default:
+      fp( p, ops[ rnd( r, 4 ) ], d, source( r ), source( r ),
+          ( t1 << 4 ) | ( t2 << 2 ) | td );
+  }
+}
+
+static void plain_op( struct program *p, struct rng *r, int cls ){
+  /* lda, add, sub, the logical operations, which have no register */
+  /*   form of mask, mul, divu, and div, and cmp                     */
+  static const unsigned int alu_imm[15] = { 0x0d, 0x1c, 0x1d, 0x10, 0x11,
+                                            0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+                                            0x1b, 0x1a, 0x1e, 0x1f },
+                            alu_reg[13] = { 0x0d, 0x1c, 0x1d, 0x10, 0x11,
+                                            0x14, 0x15, 0x16, 0x17,
+                                            0x1b, 0x1a, 0x1e, 0x1f },
+                            shifts[4] = { 0x24, 0x26, 0x28, 0x2a };
+
+  switch( cls ){
+    case C_ALU:
+      if( rnd( r, 8 ) == 0 ){
+        fp_op( p, r );
+      }else if( rnd( r, 2 ) ){
+        unsigned int op = alu_imm[ rnd( r, 15 ) ];
+        if( ( op == 0x1a ) || ( op == 0x1e ) ){
+          imm( p, op, dest( r ), source( r ), 1 + rnd( r, 0xffff ) );
+        }else{
+          imm( p, op, dest( r ), source( r ), rnd( r, 0x10000 ) );
+        }
+      }else{
+        unsigned int op = alu_reg[ rnd( r, 13 ) ];
+        if( ( op == 0x1a ) || ( op == 0x1e ) ){
+          imm( p, 0x16, 6, source( r ), 1 );           /* or r6,rS2,1 */
+          triadic( p, op, dest( r ), source( r ), 6, 0 );
+          break;
+        }
+        triadic( p, op, dest( r ), source( r ), source( r ),
+                 ( op == 0x0d ) ? rnd( r, 2 ) : 0 );
+      }
+      break;
+    case C_SHIFT:
+      bitfield( p, shifts[ rnd( r, 4 ) ], dest( r ), source( r ), rnd( r, 32 ) );
+      break;
+    case C_LOAD:  memory_op( p, r, 0 ); break;
+    case C_STORE: memory_op( p, r, 1 ); break;
+  }
+}
+
+static int pick_class( struct rng *r, int allow_branch ){
+  unsigned int total = 0, x;
+
+  for( int c = 0; c < NUM_CLASSES; c++ ){
+    if( ( c != C_BRANCH ) || allow_branch ) total += weights[ c ];
+  }
+  if( total == 0 ) return C_ALU;
+  x = rnd( r, total );
+  for( int c = 0; c < NUM_CLASSES; c++ ){
+    if( ( c == C_BRANCH ) && !allow_branch ) continue;
+    if( x < weights[ c ] ) return c;
+    x -= weights[ c ];
+  }
+  return C_ALU;
+}
+
+/* a forward skip over 1 to 4 straight-line instruction groups */
+
+static void skip( struct program *p, struct rng *r ){
+  unsigned int at, n = 1 + rnd( r, 4 ),
+               kind = ( rnd( r, 100 ) < data_branches ) ? 1 + rnd( r, 3 ) : 0;
+
+  if( kind == 3 ) triadic( p, 0x1f, 6, source( r ), source( r ), 0 );  /* cmp r6 */
+  at = p->count;
+  emit( p, 0 );   /* patched below */
+  for( unsigned int i = 0; i < n; i++ ) plain_op( p, r, pick_class( r, 0 ) );
+
+  if( kind == 1 ){
+    bcnd( p, rnd( r, 32 ), source( r ), p->count - at );
+    p->words[ at ] = p->words[ --p->count ];
+  }else if( kind == 2 ){
+    bb( p, rnd( r, 2 ), rnd( r, 32 ), source( r ), p->count - at );
+    p->words[ at ] = p->words[ --p->count ];
+  }else if( kind == 3 ){
+    bb( p, rnd( r, 2 ), 2 + rnd( r, 10 ), 6, p->count - at );
+    p->words[ at ] = p->words[ --p->count ];
+  }else if( rnd( r, 100 ) < taken ){
+    if( rnd( r, 2 ) ) br( p, p->count - at );
+    else bcnd( p, 0xf, source( r ), p->count - at );
+    p->words[ at ] = p->words[ --p->count ];
+  }else{
+    bcnd( p, 0x0, source( r ), p->count - at );
+    p->words[ at ] = p->words[ --p->count ];
+  }
+}
+
+/* bsr, or jsr through r6, to a subroutine of 1 to 4 alu and shift */
+/*   instructions and jmp r1, which returns to a br past it; r1 is   */
+/*   the return address in the subroutine, so it has no memory        */
+/*   accesses, and is set back to DATA after the call                 */
+
+static void call( struct program *p, struct rng *r ){
+  unsigned int at, sub, n = 1 + rnd( r, 4 ),
+               by_bsr = rnd( r, 2 );
+
+  if( by_bsr ){
+    at = p->count;
+    emit( p, 0 );                                /* bsr sub, patched below */
+  }else{
+    at = p->count + 2;
+    emit( p, 0 );                                /* r6 = sub, patched below */
+    emit( p, 0 );
+    emit( p, ( 0x3du << 26 ) | ( 0x32u << 10 ) | 6 );     /* jsr r6 */
+  }
+  emit( p, 0 );                                  /* br past sub, patched */
+  sub = p->count;
+  for( unsigned int i = 0; i < n; i++ ) plain_op( p, r, rnd( r, 2 ) ? C_ALU : C_SHIFT );
+  emit( p, ( 0x3du << 26 ) | ( 0x30u << 10 ) | 1 );       /* jmp r1 */
+
+  br( p, p->count - ( at + 1 ) );
+  p->words[ at + 1 ] = p->words[ --p->count ];
+  if( by_bsr ){
+    p->words[ at ] = ( 0x31u << 26 ) | ( ( sub - at ) & 0x03ffffff );
+  }else{
+    imm( p, 0x17, 6, 0, ( 4 * sub ) >> 16 );               /* or.u */
+    imm( p, 0x16, 6, 6, ( 4 * sub ) & 0xffff );            /* or */
+    p->words[ at - 1 ] = p->words[ --p->count ];
+    p->words[ at - 2 ] = p->words[ --p->count ];
+  }
+  li( p, 1, DATA );
+}
+
+static void generate( struct program *p, unsigned long long index ){
+  struct rng r;
+
+  rng_init( &r, index );
+  p->count = 0;
+
+  li( p, 1, DATA );
+  imm( p, 0x1c, 3, 0, 0 );
+  li( p, 4, rnd( &r, 0xffffffffu ) );
+  li( p, 7, stride );
+  for( unsigned int i = 8; i < 32; i++ ){
+    if( rnd( &r, 2 ) ) li( p, i, rnd( &r, 0xffffffffu ) );
+  }
+
+  for( unsigned int s = 0; s < segments; s++ ){
+    unsigned int loop = rnd( &r, 2 ), top, n = 1 + rnd( &r, body );
+
+    if( loop ) li( p, 2, 1 + rnd( &r, trips ) );
+    top = p->count;
+    for( unsigned int i = 0; i < n; i++ ){
+      int c = pick_class( &r, 1 );
+      if( c == C_BRANCH ){
+        if( rnd( &r, 4 ) ) skip( p, &r );
+        else call( p, &r );
+      }
+      else plain_op( p, &r, c );
+    }
+    if( loop ){
+      imm( p, 0x1d, 2, 2, 1 );
+      bcnd( p, 0xd, 2, (int)top - (int)p->count );
+    }
+  }
+  emit( p, 0 );   /* halt */
+}
+
+/* running a program in-process, or on a simulator program; either */
+/*   way the result is the csv statistics, or the error messages      */
+
+struct result {
+  int crashed;             /* the simulator program died of a signal */
+  char output[OUTPUT_SIZE];
+  int length;
+};
+
+static const struct engine {
+  const char *name;
+  enum sim88_engine engine;
+  int cache,
+      lockstep;
+} engines[] = {
+  { "switch",   SIM88_ENGINE_SWITCH,   0, 0 },
+  { "threaded", SIM88_ENGINE_THREADED, 0, 0 },
+  { "lockstep", SIM88_ENGINE_THREADED, 1, 1 }
+};
+
+#define NUM_ENGINES ( (int)( sizeof( engines ) / sizeof( engines[ 0 ] ) ) )
+
+static int run_engine( const struct engine *e, const struct program *p,
+                       struct result *res ){
+  struct sim88_config config;
+  struct sim88 *s;
+  char *text = NULL;
+  size_t size = 0;
+  int ok;
+
+  sim88_config_init( &config );
+  config.engine = e->engine;
+  config.cache = e->cache;
+  config.lockstep_every = e->lockstep;
+  config.out = open_memstream( &text, &size );
+  if( config.out == NULL ){
+    perror( "fuzz88: open_memstream" );
+    exit( -1 );
+  }
+  s = sim88_new( &config );
+  ok = ( s != NULL ) && ( sim88_load_words( s, p->words, p->count ) == 0 )
+       && ( sim88_run( s ) == 0 );
+  if( ok ) sim88_report( s, SIM88_STATS_CSV );
+  if( s ) sim88_free( s );
+  fclose( config.out );
+
+  res->crashed = 0;
+  res->length = ( size < OUTPUT_SIZE - 1 ) ? (int)size : OUTPUT_SIZE - 1;
+  memcpy( res->output, text, res->length );
+  res->output[ res->length ] = '\0';
+  free( text );
+  return ok;
+}
+
+static int run( const char *sim, const struct program *p, struct result *res ){
+  int in[2], out[2], status;
+  pid_t pid;
+  posix_spawn_file_actions_t actions;
+  char *argv[] = { (char *)sim, "--binary", "--lockstep",
+                   "--stats-format=csv", NULL };
+  unsigned char *image = malloc( 4 * (size_t)p->count );
+  size_t done = 0, size = 4 * (size_t)p->count;
+  ssize_t got;
+
+  for( unsigned int i = 0; i < p->count; i++ ){
+    image[ 4 * i ]     = p->words[ i ] >> 24;
+    image[ 4 * i + 1 ] = p->words[ i ] >> 16;
+    image[ 4 * i + 2 ] = p->words[ i ] >> 8;
+    image[ 4 * i + 3 ] = p->words[ i ];
+  }
+
+  /* close-on-exec, so that a simulator that another thread spawns at */
+  /*   the same time cannot hold this one's stdin open; dup2 clears it */
+  if( pipe2( in, O_CLOEXEC ) || pipe2( out, O_CLOEXEC ) ){
+    perror( "fuzz88: pipe" );
+    exit( -1 );
+  }
+  posix_spawn_file_actions_init( &actions );
+  posix_spawn_file_actions_adddup2( &actions, in[0], 0 );
+  posix_spawn_file_actions_adddup2( &actions, out[1], 1 );
+  posix_spawn_file_actions_adddup2( &actions, out[1], 2 );
+  if( posix_spawn( &pid, sim, &actions, NULL, argv, environ ) != 0 ){
+    fprintf( stderr, "fuzz88: cannot run %s\n", sim );
+    exit( -1 );
+  }
+  posix_spawn_file_actions_destroy( &actions );
+  close( in[0] );
+  close( out[1] );
+
+  /* the simulator reads all of its input before it writes anything */
+  while( done < size ){
+    got = write( in[1], image + done, size - done );
+    if( got <= 0 ) break;
+    done += got;
+  }
+  close( in[1] );
+  free( image );
+
+  res->length = 0;
+  while( ( got = read( out[0], res->output + res->length,
+                       OUTPUT_SIZE - 1 - res->length ) ) > 0 ){
+    res->length += got;
+    if( res->length == OUTPUT_SIZE - 1 ){
+      char sink[4096];
+      while( read( out[0], sink, sizeof( sink ) ) > 0 );
+      break;
+    }
+  }
+  res->output[ res->length ] = '\0';
+  close( out[0] );
+  while( waitpid( pid, &status, 0 ) < 0 && errno == EINTR );
+  res->crashed = WIFSIGNALED( status );
+  return WIFEXITED( status ) && ( WEXITSTATUS( status ) == 0 );
+}
+
+/* the core statistics and registers from the csv output, which both */
+/*   simulators print in the same order                              */
+
+static void core_columns( const struct result *res, char *buf, size_t size ){
+  const char *header = res->output,
+             *values = strchr( header, '\n' );
+  size_t used = 0;
+
+  buf[ 0 ] = '\0';
+  if( values == NULL ) return;
+  values++;
+  while( *header && ( *header != '\n' ) ){
+    const char *hend = header, *vend = values;
+    while( *hend && ( *hend != ',' ) && ( *hend != '\n' ) ) hend++;
+    while( *vend && ( *vend != ',' ) && ( *vend != '\n' ) ) vend++;
+    if( ( strncmp( header, "core.", 5 ) == 0 )
+        || ( strncmp( header, "registers.", 10 ) == 0 ) ){
+      used += snprintf( buf + used, size - used, "%.*s=%.*s\n",
+        (int)( hend - header ), header, (int)( vend - values ), values );
+      if( used >= size ) return;
+    }
+    header = ( *hend == ',' ) ? hend + 1 : hend;
+    values = ( *vend == ',' ) ? vend + 1 : vend;
+  }
+}
+
+static unsigned long long fetches_of( const struct result *res ){
+  const char *v = strstr( res->output, "core.inst_fetches" ),
+             *line = strchr( res->output, '\n' );
+  int column = 0;
+
+  if( ( v == NULL ) || ( line == NULL ) ) return 0;
+  for( const char *h = res->output; h < v; h++ ) column += ( *h == ',' );
+  line++;
+  while( column-- > 0 ){
+    line = strchr( line, ',' );
+    if( line == NULL ) return 0;
+    line++;
+  }
+  return strtoull( line, NULL, 10 );
+}
+
+/* workers */
+
+static unsigned long long programs = 1000,
+                          next_index = 0,
+                          runs = 0,
+                          instructions = 0,
+                          failures = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void save( const struct program *p, unsigned long long index ){
+  char path[4096];
+  FILE *f;
+
+  if( keep_dir == NULL ) return;
+  snprintf( path, sizeof( path ), "%s/fuzz-%llu-%llu.in", keep_dir, seed, index );
+  f = fopen( path, "w" );
+  if( f == NULL ) return;
+  for( unsigned int i = 0; i < p->count; i++ ) fprintf( f, "%08x\n", p->words[ i ] );
+  fclose( f );
+}
+
+static void report( const char *what, const char *sim, unsigned long long index,
+                    const char *detail ){
+  pthread_mutex_lock( &lock );
+  failures++;
+  printf( "%s: program %llu on %s (reproduce with --emit %llu -s %llu)\n",
+    what, index, sim, index, seed );
+  if( detail ) printf( "%s", detail );
+  pthread_mutex_unlock( &lock );
+}
+
+/* the in-process engines first, then the simulator programs */
+
+static void *worker( void *arg ){
+  struct program p = { NULL, 0, 0 };
+  struct result *res = malloc( sizeof( struct result ) );
+  static const int column_size = 4096;
+  char *first = malloc( column_size ), *other = malloc( column_size );
+
+  (void)arg;
+  for( ;; ){
+    unsigned long long index, fetched = 0;
+    int ok = 1, compared = 0;
+
+    pthread_mutex_lock( &lock );
+    index = next_index++;
+    pthread_mutex_unlock( &lock );
+    if( index >= programs ) break;
+
+    generate( &p, index );
+    for( int i = 0; i < NUM_ENGINES + num_sims; i++ ){
+      const char *name = ( i < NUM_ENGINES ) ? engines[ i ].name
+                                             : sims[ i - NUM_ENGINES ];
+      int ran = ( i < NUM_ENGINES ) ? run_engine( &engines[ i ], &p, res )
+                                    : run( name, &p, res );
+      if( !ran ){
+        const char *what = res->crashed ? "crash"
+                         : strstr( res->output, "lockstep divergence" )
+                         ? "divergence" : "failure";
+        report( what, name, index, res->output );
+        ok = 0;
+      }else if( !compared ){
+        core_columns( res, first, column_size );
+        fetched = fetches_of( res );
+        compared = 1;
+      }else{
+        core_columns( res, other, column_size );
+        if( strcmp( first, other ) ){
+          report( "engines disagree", name, index, NULL );
+          ok = 0;
+        }
+      }
+    }
+    if( !ok ) save( &p, index );
+
+    pthread_mutex_lock( &lock );
+    runs += NUM_ENGINES + num_sims;
+    instructions += fetched * ( NUM_ENGINES + num_sims );
+    pthread_mutex_unlock( &lock );
+  }
+  free( p.words );
+  free( res );
+  free( first );
+  free( other );
+  return NULL;
+}
+
+static void parse_mix( const char *spec ){
+  char *copy = strdup( spec ), *item;
+
+  for( item = strtok( copy, "," ); item; item = strtok( NULL, "," ) ){
+    char *eq = strchr( item, '=' );
+    int found = 0;
+    if( eq ){
+      *eq = '\0';
+      for( int c = 0; c < NUM_CLASSES; c++ ){
+        if( strcmp( item, class_names[ c ] ) == 0 ){
+          weights[ c ] = strtoul( eq + 1, NULL, 0 );
+          found = 1;
+        }
+      }
+    }
+    if( !found ){
+      fprintf( stderr, "fuzz88: bad --mix item %s\n", item );
+      exit( -1 );
+    }
+  }
+  free( copy );
+}
+
+static void usage( const char *name ){
+  fprintf( stderr, "usage: %s [--sim PATH ...] [-n PROGRAMS]"
+                   " [-j THREADS] [-s SEED]\n", name );
+  fprintf( stderr, "  [--mix alu=W,shift=W,load=W,store=W,branch=W]"
+                   " [--footprint BYTES]\n" );
+  fprintf( stderr, "  [--pattern imm|stride|random|all] [--stride WORDS]"
+                   " [--taken PCT]\n" );
+  fprintf( stderr, "  [--data-branches PCT] [--segments N] [--body N]"
+                   " [--trips N] [--keep DIR]\n" );
+  fprintf( stderr, "  [--emit INDEX] to print one program as hex\n" );
+  exit( -1 );
+}
+
+int main( int argc, char **argv ){
+  long threads = sysconf( _SC_NPROCESSORS_ONLN );
+  long long emit_index = -1;
+  pthread_t *pool;
+  struct timespec start, end;
+  double seconds;
+
+  for( int i = 1; i < argc; i++ ){
+    const char *a = argv[i], *v = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+    if( v == NULL ) usage( argv[0] );
+    i++;
+    if( strcmp( a, "--sim" ) == 0 ){
+      if( num_sims == MAX_SIMS ) usage( argv[0] );
+      sims[ num_sims++ ] = v;
+    }else if( strcmp( a, "-n" ) == 0 ) programs = strtoull( v, NULL, 0 );
+    else if( strcmp( a, "-j" ) == 0 ) threads = strtol( v, NULL, 0 );
+    else if( strcmp( a, "-s" ) == 0 ) seed = strtoull( v, NULL, 0 );
+    else if( strcmp( a, "--mix" ) == 0 ) parse_mix( v );
+    else if( strcmp( a, "--footprint" ) == 0 ) footprint = strtoul( v, NULL, 0 );
+    else if( strcmp( a, "--stride" ) == 0 ) stride = strtoul( v, NULL, 0 );
+    else if( strcmp( a, "--taken" ) == 0 ) taken = strtoul( v, NULL, 0 );
+    else if( strcmp( a, "--data-branches" ) == 0 ) data_branches = strtoul( v, NULL, 0 );
+    else if( strcmp( a, "--segments" ) == 0 ) segments = strtoul( v, NULL, 0 );
+    else if( strcmp( a, "--body" ) == 0 ) body = strtoul( v, NULL, 0 );
+    else if( strcmp( a, "--trips" ) == 0 ) trips = strtoul( v, NULL, 0 );
+    else if( strcmp( a, "--keep" ) == 0 ) keep_dir = v;
+    else if( strcmp( a, "--emit" ) == 0 ) emit_index = strtoll( v, NULL, 0 );
+    else if( strcmp( a, "--pattern" ) == 0 ){
+      if( strcmp( v, "imm" ) == 0 ) pattern = PAT_IMM;
+      else if( strcmp( v, "stride" ) == 0 ) pattern = PAT_STRIDE;
+      else if( strcmp( v, "random" ) == 0 ) pattern = PAT_RANDOM;
+      else if( strcmp( v, "all" ) == 0 ) pattern = PAT_ALL;
+      else usage( argv[0] );
+    }else usage( argv[0] );
+  }
+  if( ( footprint < 8 ) || ( footprint > MAX_FOOTPRINT )
+      || ( footprint & ( footprint - 1 ) ) ){
+    fprintf( stderr, "fuzz88: footprint must be a power of two from 8 to %u\n",
+      MAX_FOOTPRINT );
+    exit( -1 );
+  }
+  if( ( body == 0 ) || ( trips == 0 ) || ( threads < 1 ) ) usage( argv[0] );
+
+  if( emit_index >= 0 ){
+    struct program p = { NULL, 0, 0 };
+    generate( &p, emit_index );
+    for( unsigned int i = 0; i < p.count; i++ ) printf( "%08x\n", p.words[ i ] );
+    return 0;
+  }
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  pool = malloc( threads * sizeof( pthread_t ) );
+  for( long t = 0; t < threads; t++ ) pthread_create( &pool[ t ], NULL, worker, NULL );
+  for( long t = 0; t < threads; t++ ) pthread_join( pool[ t ], NULL );
+  clock_gettime( CLOCK_MONOTONIC, &end );
+  seconds = ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) * 1e-9;
+
+  printf( "fuzz results (in decimal):\n" );
+  printf( "  programs            = %llu\n", programs );
+  printf( "  simulator runs      = %llu\n", runs );
+  printf( "  threads             = %ld\n", threads );
+  printf( "  seconds             = %.3f\n", seconds );
+  printf( "  executions / second = %.1f\n", seconds > 0 ? runs / seconds : 0.0 );
+  printf( "  instructions        = %llu (%.1f million / second)\n", instructions,
+    seconds > 0 ? instructions / seconds / 1e6 : 0.0 );
+  printf( "  failures            = %llu\n", failures );
+  return failures ? 1 : 0;
+}